@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Reports the memory used per line by the stored syntax highlighting: the previous encoding (a ZFormatRange
+// with full styles per range and two separate states per line) against the current one (packed format id
+// runs, states shared between lines).
+//
+// Usage: highlightmemorybenchmark file...
+// Heap usage is taken from mallinfo2, so this needs glibc.
+
+#include <malloc.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+
+#include <KSyntaxHighlighting/Definition>
+#include <KSyntaxHighlighting/State>
+
+#include <Tui/ZFormatRange.h>
+#include <Tui/ZTextStyle.h>
+
+#include "file.h"
+#include "syntaxrepository.h"
+
+// Line data as it was stored before the compact encoding.
+struct LegacyExtraData : public Tui::ZDocumentLineUserData {
+    KSyntaxHighlighting::State stateBegin;
+    KSyntaxHighlighting::State stateEnd;
+    QVector<Tui::ZFormatRange> highlights;
+    unsigned lineRevision = -1;
+};
+
+static qint64 heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+static qint64 measureLegacy(const QStringList &lines, HighlightExporter &exporter) {
+    std::vector<std::shared_ptr<LegacyExtraData>> data;
+    data.reserve(lines.size());
+
+    const qint64 start = heapInUse();
+    const Tui::ZTextStyle style({0xff, 0xff, 0xff}, {0, 0, 0xaa});
+    KSyntaxHighlighting::State state;
+    for (const QString &line: lines) {
+        auto lineData = std::make_shared<LegacyExtraData>();
+        lineData->stateBegin = state;
+        auto res = exporter.highlightLineWrap(line, state);
+        lineData->stateEnd = state = std::get<0>(res);
+        const SyntaxRuns &runs = std::get<1>(res);
+        for (int i = 0; i < runs.size(); i++) {
+            lineData->highlights.append(Tui::ZFormatRange(runs.at(i).offset, runs.at(i).length, style, style, 3));
+        }
+        data.push_back(lineData);
+    }
+    return heapInUse() - start;
+}
+
+static qint64 measureCompact(const QStringList &lines, HighlightExporter &exporter) {
+    std::vector<std::shared_ptr<ExtraData>> data;
+    data.reserve(lines.size());
+
+    const qint64 start = heapInUse();
+    SyntaxStateCache stateCache;
+    KSyntaxHighlighting::State state;
+    for (const QString &line: lines) {
+        auto lineData = std::make_shared<ExtraData>();
+        lineData->stateBegin = state;
+        auto res = exporter.highlightLineWrap(line, state);
+        lineData->stateEnd = state = stateCache.deduplicate(std::get<0>(res));
+        lineData->formats = std::get<1>(res);
+        data.push_back(lineData);
+    }
+    return heapInUse() - start;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    const QStringList filenames = app.arguments().mid(1);
+    if (filenames.isEmpty()) {
+        printf("Usage: highlightmemorybenchmark file...\n");
+        return 1;
+    }
+
+    for (const QString &filename: filenames) {
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly)) {
+            printf("%s: could not open\n", qPrintable(filename));
+            continue;
+        }
+        const QStringList lines = QString::fromUtf8(file.readAll()).split('\n');
+
+        const KSyntaxHighlighting::Definition definition = syntaxRepository().definitionForFileName(filename);
+        if (!definition.isValid()) {
+            printf("%s: no syntax definition\n", qPrintable(filename));
+            continue;
+        }
+        definition.includedDefinitions();
+
+        HighlightExporter exporter;
+        exporter.setDefinition(definition);
+
+        qint64 textBytes = 0;
+        for (const QString &line: lines) {
+            textBytes += line.size() * 2;
+        }
+
+        const double lineCount = std::max(1, lines.size());
+        const qint64 legacy = measureLegacy(lines, exporter);
+        const qint64 compact = measureCompact(lines, exporter);
+        printf("%s: %d lines, %s\n", qPrintable(filename), lines.size(), qPrintable(definition.name()));
+        printf("  text              %8.1f bytes per line\n", textBytes / lineCount);
+        printf("  highlight before  %8.1f bytes per line\n", legacy / lineCount);
+        printf("  highlight after   %8.1f bytes per line (%.0f%%)\n", compact / lineCount,
+               legacy ? 100.0 * compact / legacy : 0.0);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Compares the file loading path of chr (fileloader.cpp) with ZTextEdit::readFrom.
+//
+// Usage: loadbenchmark [size in MiB]...
+// Without arguments files of 100 MiB and 1000 MiB are generated, each as pure ASCII and as mixed UTF-8.
+// Files above 1 GiB do not fit into a single QString, loadText reports these as too large and chr falls
+// back to readFrom.
+
+#include <stdio.h>
+
+#include <functional>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <Tui/ZTerminal.h>
+#include <Tui/ZTextEdit.h>
+
+#include "fileloader.h"
+
+static bool writeTestFile(const QString &filename, qint64 size, bool mixed) {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    const QByteArray asciiLine = "The quick brown fox jumps over the lazy dog 0123456789\n";
+    const QByteArray mixedLine = "Falsches Üben von Xylophonmusik quält jeden größeren Zwerg €\n";
+
+    QByteArray block;
+    int lineNumber = 0;
+    while (block.size() < 1024 * 1024) {
+        block += QByteArray::number(lineNumber++) + " ";
+        block += (mixed && lineNumber % 2) ? mixedLine : asciiLine;
+    }
+
+    for (qint64 written = 0; written < size; written += block.size()) {
+        if (file.write(block) != block.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void measure(const char *name, const std::function<bool()> &f) {
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = f();
+    printf("  %-24s %8lld ms%s\n", name, static_cast<long long>(timer.elapsed()), ok ? "" : " (failed)");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QList<qint64> sizesMiB;
+    for (const QString &arg: app.arguments().mid(1)) {
+        sizesMiB.append(arg.toLongLong());
+    }
+    if (sizesMiB.isEmpty()) {
+        sizesMiB = {100, 1000};
+    }
+
+    Tui::ZTerminal::OffScreen offscreen(80, 24);
+    Tui::ZTerminal terminal(offscreen);
+
+    QTemporaryDir dir;
+    const QString filename = dir.path() + "/input";
+
+    for (qint64 sizeMiB: sizesMiB) {
+        for (bool mixed: {false, true}) {
+            if (!writeTestFile(filename, sizeMiB * 1024 * 1024, mixed)) {
+                printf("Could not write test file.\n");
+                return 1;
+            }
+            printf("%lld MiB %s\n", static_cast<long long>(sizeMiB), mixed ? "mixed UTF-8" : "ASCII");
+
+            measure("ZTextEdit::readFrom", [&] {
+                Tui::ZTextEdit edit(terminal.textMetrics(), nullptr);
+                QFile file(filename);
+                if (!file.open(QIODevice::ReadOnly)) {
+                    return false;
+                }
+                return edit.readFrom(&file, {0, 0});
+            });
+
+            measure("loadText", [&] {
+                const std::atomic<bool> cancel = false;
+                return loadText(filename, cancel, {}).ok;
+            });
+
+            measure("loadText + setText", [&] {
+                const std::atomic<bool> cancel = false;
+                LoadedText result = loadText(filename, cancel, {});
+                Tui::ZTextEdit edit(terminal.textMetrics(), nullptr);
+                edit.setText(result.text);
+                return result.ok;
+            });
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: BSL-1.0
+
+// Measures the time to set up the File widget of a new window, as done for every file given on the command line.
+// "private repository" additionally creates a KSyntaxHighlighting::Repository for every window, which is what
+// each File did before the repository was shared.
+//
+// Usage: windowbenchmark [number of windows]
+// The default is 50 windows.
+
+#include <stdio.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#ifdef SYNTAX_HIGHLIGHTING
+#include <KSyntaxHighlighting/Repository>
+#endif
+
+#include <Tui/ZTerminal.h>
+
+#include "file.h"
+
+static void measure(const char *name, int windows, const std::function<void()> &f) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < windows; i++) {
+        f();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    printf("  %-24s %8.2f ms per window\n", name, elapsed / 1e6 / std::max(1, windows));
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+#ifdef SYNTAX_HIGHLIGHTING
+    Q_INIT_RESOURCE(syntax);
+#endif
+
+    QCoreApplication app(argc, argv);
+
+    int windows = 50;
+    if (app.arguments().size() > 1) {
+        windows = app.arguments().at(1).toInt();
+    }
+
+    Tui::ZTerminal::OffScreen offscreen(80, 24);
+    Tui::ZTerminal terminal(offscreen);
+
+    std::vector<std::unique_ptr<File>> files;
+
+    auto createFile = [&] {
+        auto file = std::make_unique<File>(terminal.textMetrics(), nullptr);
+        file->setSyntaxHighlightingTheme("chr-bluebg");
+        file->setSyntaxHighlightingLanguage("C++");
+        files.push_back(std::move(file));
+    };
+
+    printf("%d windows\n", windows);
+
+    measure("shared repository", windows, createFile);
+    files.clear();
+
+#ifdef SYNTAX_HIGHLIGHTING
+    std::vector<std::unique_ptr<KSyntaxHighlighting::Repository>> repositories;
+    measure("private repository", windows, [&] {
+        auto repository = std::make_unique<KSyntaxHighlighting::Repository>();
+        repository->theme("chr-bluebg");
+        repository->definitionForName("C++").includedDefinitions();
+        repositories.push_back(std::move(repository));
+        createFile();
+    });
+#endif
+
+    return 0;
+}
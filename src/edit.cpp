@@ -87,6 +87,7 @@ void Editor::setupUi() {
                                  { "<m>W</m>rap long lines", "", "Wrap", {}},
     //                             { "Following (standard input)", "", "Following", {}},
                                  { "Stop Input Pipe", "", "StopInputPipe", {}},
+                                 { "F<m>o</m>llow File", "", "FollowFile", {}},
                                  { "<m>H</m>ighlight Brackets", "", "Brackets", {}},
                                  { "<m>S</m>yntax Highlighting", "", "SyntaxHighlighting", {}},
                                  { "<m>T</m>heme", "", "Theme", {}}
@@ -450,16 +451,20 @@ FileWindow *Editor::createFileWindow() {
     _mux.connect(win, win, &FileWindow::readFromStandadInput, _statusBar, &StatusBar::readFromStandardInput, false);
     //_mux.connect(win, win, &FileWindow::followStandadInput, _statusBar, &StatusBar::followStandardInput, false);
     _mux.connect(win, file, &File::followStandardInputChanged, _statusBar, &StatusBar::followStandardInput, false);
+    _mux.connect(win, win, &FileWindow::followFileChanged, _statusBar, &StatusBar::followFile, false);
     _mux.connect(win, file, &File::writableChanged, _statusBar, &StatusBar::setWritable, true);
     _mux.connect(win, file->document(), &Tui::ZDocument::crLfModeChanged, _statusBar, &StatusBar::crlfMode, false);
     _mux.connect(win, file, &File::selectModeChanged, _statusBar, &StatusBar::modifiedSelectMode, false);
-    _mux.connect(win, file, &File::searchCountChanged, _statusBar, &StatusBar::searchCount, -1);
+    _mux.connect(win, file, &File::searchCountChanged, _statusBar, &StatusBar::searchCount, -1, true);
+    _mux.connect(win, file, &File::searchMatchChanged, _statusBar, &StatusBar::searchMatch, 0);
     _mux.connect(win, file, &File::searchTextChanged, _statusBar, &StatusBar::searchText, QString());
     _mux.connect(win, file, &File::searchVisibleChanged, _statusBar, &StatusBar::searchVisible, false);
     _mux.connect(win, file, &File::overwriteModeChanged, _statusBar, &StatusBar::overwrite, false);
     _mux.connect(win, win, &FileWindow::fileChangedExternally, _statusBar, &StatusBar::fileHasBeenChangedExternally, false);
     _mux.connect(win, file, &File::syntaxHighlightingEnabledChanged, _statusBar, &StatusBar::syntaxHighlightingEnabled, false);
     _mux.connect(win, file, &File::syntaxHighlightingLanguageChanged, _statusBar, &StatusBar::language, QString());
+    _mux.connect(win, file, &File::syntaxHighlightingDegradedChanged, _statusBar, &StatusBar::syntaxHighlightingDegraded, false);
+    _mux.connect(win, file, &File::loadingProgressChanged, _statusBar, &StatusBar::loadingProgress, qint64(-1), qint64(-1), 0);
 
     _allWindows.append(win);
     ensureWindowCommands(_allWindows.size());
@@ -517,6 +522,8 @@ FileWindow *Editor::createFileWindow() {
         file->setRightMarginHint(_file->rightMarginHint());
         file->setHighlightBracket(_file->highlightBracket());
         file->setAttributesFile(_file->attributesFile());
+        file->setPagedViewThreshold(_file->pagedViewThreshold());
+        file->setStandardInputLimits(_file->standardInputMaxLines(), _file->standardInputMaxBytes());
         file->setSyntaxHighlightingTheme(_initialFileSettings.syntaxHighlightingTheme);
         file->setSyntaxHighlightingActive(_file->syntaxHighlightingActive());
     } else {
@@ -531,6 +538,8 @@ FileWindow *Editor::createFileWindow() {
         file->setRightMarginHint(_initialFileSettings.rightMarginHint);
         file->setHighlightBracket(_initialFileSettings.highlightBracket);
         file->setAttributesFile(_initialFileSettings.attributesFile);
+        file->setPagedViewThreshold(_initialFileSettings.pagedViewThreshold);
+        file->setStandardInputLimits(_initialFileSettings.stdinMaxLines, _initialFileSettings.stdinMaxBytes);
         file->setSyntaxHighlightingTheme(_initialFileSettings.syntaxHighlightingTheme);
         file->setSyntaxHighlightingActive(!_initialFileSettings.disableSyntaxHighlighting);
     }
@@ -916,6 +925,8 @@ void Editor::setTheme(Theme theme) {
 
 void Editor::setInitialFileSettings(const Settings &initial) {
     _initialFileSettings = initial;
+    File::setSyntaxHighlightingMemoryBudget(initial.syntaxHighlightingMemory);
+    File::setSyntaxHighlightingCacheSize(initial.syntaxHighlightingCacheSize);
 }
 
 void Editor::showCommandLine() {
@@ -34,6 +34,11 @@ public:
     int rightMarginHint = 0;
     QString syntaxHighlightingTheme;
     bool disableSyntaxHighlighting = false;
+    qint64 pagedViewThreshold = 0;
+    int stdinMaxLines = 0;
+    qint64 stdinMaxBytes = 0;
+    qint64 syntaxHighlightingMemory = 0;
+    qint64 syntaxHighlightingCacheSize = 0;
 };
 
 class Editor : public Tui::ZRoot {
@@ -2,11 +2,19 @@
 
 #include "file.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <limits>
+
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QSaveFile>
+#include <QThread>
+#include <QTimer>
 #include <QtConcurrent>
 
 #ifdef SYNTAX_HIGHLIGHTING
@@ -27,16 +35,78 @@
 #include <Tui/ZTextMetrics.h>
 
 #include "attributes.h"
+#include "highlightcache.h"
 #include "searchcount.h"
+#include "syntaxdetect.h"
+#include "syntaxrepository.h"
+
+// Time the paint event may spend on highlighting lines itself, in milliseconds.
+static constexpr double syntaxHighlightingPaintBudget = 10;
+// Time after which a highlighting job that is still running is shown in the status bar, in milliseconds.
+static constexpr int syntaxHighlightingJobBudget = 1000;
 
 // User Data values for ZFormatRange ranges.
 #define FR_UD_SELECTION 1
 #define FR_UD_LIVE_SEARCH 2
 #define FR_UD_SYNTAX 3
 
+#ifdef SYNTAX_HIGHLIGHTING
+static qint64 syntaxHighlightingBudget = 0;
+
+// All documents, the most recently focused first.
+static std::vector<File*> &syntaxHighlightingFiles() {
+    static std::vector<File*> files;
+    return files;
+}
+
+static qint64 syntaxRunsMemory(const ExtraData &data) {
+    return data.evicted ? 0 : data.formats.memoryUsage();
+}
+
+static qint64 syntaxHighlightingCacheBytes = 0;
+// Smaller files are highlighted fast enough without the cache.
+static constexpr int syntaxHighlightingCacheMinLines = 1000;
+
+// Format ids are assigned while definitions are loaded and differ between runs, the highlight cache refers to
+// formats by the name of their definition and their own name.
+static QHash<QString, KSyntaxHighlighting::Format> syntaxFormatsByName(const KSyntaxHighlighting::Definition &definition) {
+    QHash<QString, KSyntaxHighlighting::Format> formats;
+    auto addFormats = [&](const KSyntaxHighlighting::Definition &def) {
+        for (const KSyntaxHighlighting::Format &format: def.formats()) {
+            formats.insert(def.name() + "/" + format.name(), format);
+        }
+    };
+    addFormats(definition);
+    for (const KSyntaxHighlighting::Definition &included: definition.includedDefinitions()) {
+        addFormats(included);
+    }
+    return formats;
+}
+
+static QString syntaxHighlightingCacheKey(const KSyntaxHighlighting::Definition &definition) {
+    return definition.name() + " " + QString::number(definition.version());
+}
+
+struct DetectedSyntax {
+    QDateTime lastModified;
+    qint64 size = 0;
+    // Empty if nothing was detected.
+    QString definition;
+};
+
+// Results of the content based detection by absolute path, so files that are opened again are not read again.
+static QHash<QString, DetectedSyntax> &detectedSyntaxCache() {
+    static QHash<QString, DetectedSyntax> cache;
+    return cache;
+}
+#endif
+
 File::File(Tui::ZTextMetrics textMetrics, Tui::ZWidget *parent)
     : ZTextEdit(textMetrics, parent)
 {
+#ifdef SYNTAX_HIGHLIGHTING
+    syntaxHighlightingFiles().push_back(this);
+#endif
     _lineMarker = std::make_unique<MarkerManager>();
 
     setInsertCursorStyle(Tui::CursorStyle::Underline);
@@ -76,13 +146,46 @@ File::File(Tui::ZTextMetrics textMetrics, Tui::ZWidget *parent)
             // line, so send an update out.
             const auto [cursorCodeUnit, cursorLine, cursorColumn] = cursorPositionOrBlockSelectionEnd();
             int utf8PositionX = document()->line(cursorLine).left(cursorCodeUnit).toUtf8().size();
-            cursorPositionChanged(cursorColumn, cursorCodeUnit, utf8PositionX, cursorLine);
+            cursorPositionChanged(cursorColumn, cursorCodeUnit, utf8PositionX, _pageFirstLine + cursorLine);
+        }
+    });
+
+    QObject::connect(this, &File::scrollPositionChanged, this, [this] {
+        // Scrolling without moving the cursor does not call adjustScrollPosition, so check the paged window
+        // from here too. Delayed because the document can not be replaced while ZTextEdit is scrolling.
+        if (_mappedFile && !_pagedCheckPending) {
+            _pagedCheckPending = true;
+            QTimer::singleShot(0, this, [this] {
+                _pagedCheckPending = false;
+                pagedCheckWindow();
+            });
         }
     });
 
+    qRegisterMetaType<LoadedText>();
+    qRegisterMetaType<std::shared_ptr<const SearchIndex>>();
+
+    QObject::connect(document(), &Tui::ZDocument::contentsChanged, this, &File::updateSearchIndex);
+
 #ifdef SYNTAX_HIGHLIGHTING
     qRegisterMetaType<Updates>();
 
+    _syntaxHighlightSweepTimer = new QTimer(this);
+    _syntaxHighlightSweepTimer->setSingleShot(true);
+    _syntaxHighlightSweepTimer->setInterval(500);
+    QObject::connect(_syntaxHighlightSweepTimer, &QTimer::timeout, this, [this] {
+        _syntaxHighlightSweepPending = true;
+        updateSyntaxHighlighting(false);
+    });
+
+    _syntaxHighlightBudgetTimer = new QTimer(this);
+    _syntaxHighlightBudgetTimer->setSingleShot(true);
+    _syntaxHighlightBudgetTimer->setInterval(syntaxHighlightingJobBudget);
+    QObject::connect(_syntaxHighlightBudgetTimer, &QTimer::timeout, this, [this] {
+        _syntaxHighlightOverBudget = true;
+        update();
+    });
+
     QObject::connect(document(), &Tui::ZDocument::contentsChanged, this, [this] {
         updateSyntaxHighlighting(false);
     });
@@ -93,9 +196,9 @@ File::File(Tui::ZTextMetrics textMetrics, Tui::ZWidget *parent)
 void File::emitCursorPostionChanged() {
     const auto [cursorCodeUnit, cursorLine, cursorColumn] = cursorPositionOrBlockSelectionEnd();
     int utf8CodeUnit = document()->line(cursorLine).leftRef(cursorCodeUnit).toUtf8().size();
-    cursorPositionChanged(cursorColumn, cursorCodeUnit, utf8CodeUnit, cursorLine);
+    cursorPositionChanged(cursorColumn, cursorCodeUnit, utf8CodeUnit, _pageFirstLine + cursorLine);
 
-    if (_stdin && document()->lineCount() - 1 == cursorLine) {
+    if ((_stdin || _followFile) && document()->lineCount() - 1 == cursorLine) {
         _followMode = true;
         followStandardInputChanged(true);
     } else {
@@ -107,151 +210,898 @@ void File::emitCursorPostionChanged() {
 #ifdef SYNTAX_HIGHLIGHTING
 
 void File::updateSyntaxHighlighting(bool force = false) {
+    _syntaxHighlightingCounters.requested++;
     if (force) {
         document()->setLineUserData(0, nullptr);
+        _syntaxHighlightDirtyLine = 0;
+        _syntaxHighlightAppendLine = -1;
+        _syntaxHighlightSweepPending = true;
+        // Results of a running job are for the old definition
+        (*_syntaxHighlightGeneration)++;
+    } else {
+        _syntaxHighlightDirtyLine = std::min(_syntaxHighlightDirtyLine, cursorPosition().line);
     }
     if (!syntaxHighlightingActive() || !_syntaxHighlightDefinition.isValid()
             || !_syntaxHighlightingTheme.isValid()) {
         return;
     }
 
+    // All changes done in one event loop iteration (e.g. by replace all) are handled by one job.
+    if (!_syntaxHighlightJobScheduled) {
+        _syntaxHighlightJobScheduled = true;
+        QTimer::singleShot(0, this, [this] {
+            _syntaxHighlightJobScheduled = false;
+            startSyntaxHighlightingJob();
+        });
+    }
+}
+
+void File::startSyntaxHighlightingJob() {
+    if (_syntaxHighlightJobRunning) {
+        // The running job stops as soon as it notices the change, the next job is started when it has finished.
+        _syntaxHighlightRestartPending = true;
+        return;
+    }
+    if (!syntaxHighlightingActive() || !_syntaxHighlightDefinition.isValid()
+            || !_syntaxHighlightingTheme.isValid()) {
+        return;
+    }
+
+    // When lines were only appended (standard input, followed files), just the new lines are highlighted,
+    // starting from the end state of the line before them. Nothing else can have changed, so no sweep is needed.
+    if (_syntaxHighlightAppendLine >= 0 && _syntaxHighlightAppendRevision != document()->revision()) {
+        _syntaxHighlightAppendLine = -1;
+    }
+    const int appendLine = _syntaxHighlightAppendLine;
+
+    // Edits that do not happen at the cursor (undo, replace all, ...) are only found by a sweep over the whole
+    // document, which is delayed until the user pauses typing.
+    const bool sweep = appendLine < 0 && std::exchange(_syntaxHighlightSweepPending, false);
+    if (!sweep && appendLine < 0) {
+        _syntaxHighlightSweepTimer->start();
+    }
+
+    const int dirtyLine = _syntaxHighlightDirtyLine;
+    const int visibleLinesStart = scrollPositionLine();
+    const int visibleLinesEnd = visibleLinesStart + geometry().height() + 1;
+
     Tui::ZDocumentSnapshot snapshot = document()->snapshot();
     SyntaxHighlightingSignalForwarder *forwarder = new SyntaxHighlightingSignalForwarder();
     forwarder->moveToThread(nullptr); // enable later pull to worker thread
     QObject::connect(forwarder, &SyntaxHighlightingSignalForwarder::updates, this, &File::ingestSyntaxHighlightingUpdates);
+    QObject::connect(forwarder, &SyntaxHighlightingSignalForwarder::finished, this, &File::syntaxHighlightingJobFinished);
 
-    QtConcurrent::run([forwarder, snapshot, &highlighter=_syntaxHighlightExporter] {
+    _syntaxHighlightJobRunning = true;
+    _syntaxHighlightingCounters.queued++;
+    if (!_syntaxHighlightOverBudget && !_syntaxHighlightBudgetTimer->isActive()) {
+        _syntaxHighlightBudgetTimer->start();
+    }
+
+    QtConcurrent::run([forwarder, snapshot, pool=_syntaxHighlighterPool, dirtyLine, appendLine, visibleLinesStart,
+                      visibleLinesEnd, sweep, generationCounter=_syntaxHighlightGeneration,
+                      generation=_syntaxHighlightGeneration->load()] {
         forwarder->moveToThread(QThread::currentThread());
 
+        HighlighterPool::Lease highlighter = pool->acquire();
+
         Updates updates;
         updates.documentRevision = snapshot.revision();
+        updates.documentLineCount = snapshot.lineCount();
+        updates.generation = generation;
+
+        // Limit the work between two updates, so that results show up steadily.
+        QElapsedTimer sinceLastSend;
+        sinceLastSend.start();
+
+        const int lineCount = snapshot.lineCount();
+        bool upToDate = true;
+
+        // Lines highlighted by this job, the snapshot does not know about them.
+        QHash<int, std::shared_ptr<ExtraData>> computed;
 
         auto sendData = [&] {
             forwarder->updates(updates);
+            updates.data.clear();
+            updates.lines.clear();
+            updates.texts.clear();
+            sinceLastSend.restart();
         };
 
-        auto update = [&](int line, std::shared_ptr<ExtraData> &newData) {
+        auto update = [&](int line, const QString &text, std::shared_ptr<ExtraData> &newData) {
+            computed.insert(line, newData);
             updates.data.append(newData);
             updates.lines.append(line);
+            updates.texts.append(text);
 
-            if (updates.data.size() > 100) {
+            if (updates.data.size() > 100 || sinceLastSend.elapsed() > 20) {
                 sendData();
-                updates.data.clear();
-                updates.lines.clear();
             }
         };
 
-        KSyntaxHighlighting::State state;
-        for (int line = 0; line < snapshot.lineCount(); line++) {
-            if (!snapshot.isUpToDate()) {
-                // Abandon work, the document has changed
-                delete forwarder;
-                return;
+        auto currentData = [&](int line) -> std::shared_ptr<const ExtraData> {
+            auto it = computed.constFind(line);
+            if (it != computed.constEnd()) {
+                return *it;
             }
             auto userData = std::static_pointer_cast<const ExtraData>(snapshot.lineUserData(line));
-            if (!userData || userData->stateBegin != state || userData->lineRevision != snapshot.lineRevision(line)) {
-                auto newData = std::make_shared<ExtraData>();
-                newData->stateBegin = state;
-                auto res = highlighter.highlightLineWrap(snapshot.line(line), state);
-                newData->stateEnd = state = std::get<0>(res);
-                newData->highlights = std::get<1>(res);
-                newData->lineRevision = snapshot.lineRevision(line);
-
-                update(line, newData);
-            } else {
-                state = userData->stateEnd;
+            if (userData && !userData->cached && userData->lineRevision == snapshot.lineRevision(line)) {
+                return userData;
+            }
+            return nullptr;
+        };
+
+        // The stored end state of the nearest unchanged line before `line` is used as checkpoint, so the
+        // unchanged prefix of the document does not need to be walked.
+        auto resumePoint = [&](int line) -> std::tuple<int, KSyntaxHighlighting::State> {
+            for (int i = line - 1; i >= 0; i--) {
+                if (auto data = currentData(i)) {
+                    return {i + 1, data->stateEnd};
+                }
+            }
+            return {0, KSyntaxHighlighting::State()};
+        };
+
+        auto abandoned = [&] {
+            return !snapshot.isUpToDate() || *generationCounter != generation;
+        };
+
+        SyntaxStateCache stateCache;
+
+        auto highlightLine = [&](HighlightExporter &exporter, SyntaxStateCache &cache, int line, const QString &text,
+                                 KSyntaxHighlighting::State &state) {
+            auto newData = std::make_shared<ExtraData>();
+            newData->stateBegin = state;
+            auto res = exporter.highlightLineWrap(text, state);
+            newData->stateEnd = state = cache.deduplicate(std::get<0>(res));
+            newData->formats = std::get<1>(res);
+            newData->partial = text.size() > HighlightExporter::maxLineLength;
+            newData->lineRevision = snapshot.lineRevision(line);
+            return newData;
+        };
+
+        // Returns false when the document has changed and the work was abandoned.
+        auto highlightLines = [&](int line, KSyntaxHighlighting::State state, int endLine, bool stopWhenConverged) {
+            for (; line < endLine; line++) {
+                if (abandoned()) {
+                    return false;
+                }
+                auto data = currentData(line);
+                if (data && data->stateBegin == state) {
+                    if (stopWhenConverged) {
+                        // All following lines already have been highlighted starting from the same state.
+                        return true;
+                    }
+                    state = data->stateEnd;
+                    continue;
+                }
+                const QString text = snapshot.line(line);
+                auto newData = highlightLine(*highlighter, stateCache, line, text, state);
+                update(line, text, newData);
+            }
+            return true;
+        };
+
+        // For big documents the lines are split into chunks that are highlighted in parallel. Each chunk starts
+        // with a guessed state: the stored begin state of its first line, or the default state. Afterwards the
+        // chunks are stitched together in order. Where the guess was wrong, lines are highlighted again from the
+        // real state until that matches the guessed begin state of a line, for most languages after a few lines.
+        struct Chunk {
+            int begin = 0;
+            int end = 0;
+            KSyntaxHighlighting::State guess;
+            KSyntaxHighlighting::State stateEnd;
+            // Lines that already had up to date highlighting for the guessed state are null.
+            QVector<std::shared_ptr<ExtraData>> data;
+            QStringList texts;
+            bool upToDate = false;
+        };
+
+        auto highlightParallel = [&] {
+            const int chunkLines = std::max(1000, lineCount / (QThread::idealThreadCount() * 4));
+            QVector<Chunk> chunks;
+            for (int begin = 0; begin < lineCount; begin += chunkLines) {
+                Chunk chunk;
+                chunk.begin = begin;
+                chunk.end = std::min(begin + chunkLines, lineCount);
+                chunks.append(chunk);
             }
+
+            QtConcurrent::blockingMap(chunks, [&](Chunk &chunk) {
+                HighlighterPool::Lease chunkHighlighter = pool->acquire();
+                SyntaxStateCache chunkStateCache;
+                KSyntaxHighlighting::State state;
+                if (chunk.begin > 0) {
+                    if (auto data = currentData(chunk.begin)) {
+                        state = data->stateBegin;
+                    }
+                }
+                chunk.guess = state;
+                chunk.data.resize(chunk.end - chunk.begin);
+                for (int line = chunk.begin; line < chunk.end; line++) {
+                    chunk.texts.append(snapshot.line(line));
+                }
+                for (int line = chunk.begin; line < chunk.end; line++) {
+                    if (abandoned()) {
+                        return;
+                    }
+                    auto data = currentData(line);
+                    if (data && data->stateBegin == state) {
+                        state = data->stateEnd;
+                        continue;
+                    }
+                    chunk.data[line - chunk.begin] = highlightLine(*chunkHighlighter, chunkStateCache, line,
+                                                                   chunk.texts[line - chunk.begin], state);
+                }
+                chunk.stateEnd = state;
+                chunk.upToDate = true;
+            });
+
+            KSyntaxHighlighting::State state;
+            for (Chunk &chunk: chunks) {
+                if (!chunk.upToDate || abandoned()) {
+                    return false;
+                }
+                if (chunk.guess != state) {
+                    bool converged = false;
+                    for (int line = chunk.begin; line < chunk.end; line++) {
+                        if (abandoned()) {
+                            return false;
+                        }
+                        std::shared_ptr<ExtraData> &guessed = chunk.data[line - chunk.begin];
+                        const KSyntaxHighlighting::State guessedBegin = guessed ? guessed->stateBegin
+                                                                                : currentData(line)->stateBegin;
+                        if (guessedBegin == state) {
+                            converged = true;
+                            break;
+                        }
+                        guessed = highlightLine(*highlighter, stateCache, line, chunk.texts[line - chunk.begin], state);
+                    }
+                    if (converged) {
+                        state = chunk.stateEnd;
+                    }
+                } else {
+                    state = chunk.stateEnd;
+                }
+                for (int line = chunk.begin; line < chunk.end; line++) {
+                    std::shared_ptr<ExtraData> &newData = chunk.data[line - chunk.begin];
+                    if (newData) {
+                        update(line, chunk.texts[line - chunk.begin], newData);
+                    }
+                }
+            }
+            return true;
+        };
+
+
+        if (appendLine >= 0) {
+            // Lines that were highlighted by an earlier job that was abandoned are skipped.
+            auto [line, state] = resumePoint(std::min(appendLine, lineCount));
+            upToDate = highlightLines(line, state, lineCount, false);
+        } else if (visibleLinesStart < lineCount) {
+            // The visible lines first, with the best state known so far. If an edit above changes their begin
+            // state they are corrected by the next step.
+            auto [line, state] = resumePoint(visibleLinesStart);
+            upToDate = highlightLines(line, state, std::min(visibleLinesEnd, lineCount), false);
+            if (updates.data.size()) {
+                sendData();
+            }
+        }
+
+        // A sweep covers the dirty lines too.
+        if (upToDate && sweep && QThread::idealThreadCount() > 1 && lineCount >= 10000) {
+            upToDate = highlightParallel();
+        } else if (upToDate && sweep) {
+            upToDate = highlightLines(0, KSyntaxHighlighting::State(), lineCount, false);
+        } else if (upToDate && appendLine < 0 && dirtyLine < lineCount) {
+            auto [line, state] = resumePoint(dirtyLine);
+            upToDate = highlightLines(line, state, lineCount, true);
         }
 
-        if (updates.data.size()) {
+        if (upToDate) {
+            updates.complete = true;
+            sendData();
+        } else if (updates.data.size()) {
+            // Abandon work, the document has changed. What is already done can still be used for unchanged lines.
             sendData();
         }
+        forwarder->finished(upToDate);
         delete forwarder;
     });
 }
 
+void File::syntaxHighlightingJobFinished(bool completed) {
+    _syntaxHighlightJobRunning = false;
+    if (completed) {
+        _syntaxHighlightingCounters.completed++;
+    } else {
+        _syntaxHighlightingCounters.abandoned++;
+    }
+    if (std::exchange(_syntaxHighlightRestartPending, false)) {
+        startSyntaxHighlightingJob();
+    } else {
+        _syntaxHighlightBudgetTimer->stop();
+        if (std::exchange(_syntaxHighlightOverBudget, false)) {
+            update();
+        }
+    }
+}
+
 void File::syntaxHighlightDefinition() {
     if (_syntaxHighlightDefinition.isValid()) {
-        _syntaxHighlightExporter.setTheme(_syntaxHighlightingTheme);
-        _syntaxHighlightExporter.setDefinition(_syntaxHighlightDefinition);
-        _syntaxHighlightExporter.defBg = getColor("chr.editBg");
-        _syntaxHighlightExporter.defFg = getColor("chr.editFg");
+        // Definitions are loaded lazily. Load this definition and everything it includes now, the remaining
+        // lazy preparation when rules are first matched is serialized by SyntaxDefinitionLock.
+        _syntaxHighlightDefinition.includedDefinitions();
+        configureSyntaxHighlighters();
         _syntaxHighlightingLanguage = _syntaxHighlightDefinition.name();
         syntaxHighlightingLanguageChanged(_syntaxHighlightingLanguage);
     }
 }
 
+void File::detectSyntaxDefinition() {
+    const unsigned detection = ++_syntaxDetection;
+    _syntaxHighlightDefinition = syntaxRepository().definitionForFileName(getFilename());
+    syntaxHighlightDefinition();
+    if (_syntaxHighlightDefinition.isValid() || _mappedFile) {
+        // The paged view only holds a window of the file, its content is not looked at.
+        return;
+    }
+
+    const QFileInfo info(getFilename());
+    const QString path = info.absoluteFilePath();
+    auto cached = detectedSyntaxCache().constFind(path);
+    if (cached != detectedSyntaxCache().constEnd() && cached->lastModified == info.lastModified()
+            && cached->size == info.size()) {
+        if (!cached->definition.isEmpty()) {
+            _syntaxHighlightDefinition = syntaxRepository().definitionForName(cached->definition);
+            syntaxHighlightDefinition();
+        }
+        return;
+    }
+
+    // Shebang, modelines and file headers are looked for in a worker thread, until then the file is shown
+    // without highlighting.
+    auto watcher = new QFutureWatcher<SyntaxHint>(this);
+    QObject::connect(watcher, &QFutureWatcher<SyntaxHint>::finished, this,
+                     [this, watcher, detection, path, lastModified=info.lastModified(), size=info.size()] {
+        watcher->deleteLater();
+        const KSyntaxHighlighting::Definition definition = definitionForSyntaxHint(watcher->result());
+        detectedSyntaxCache().insert(path, {lastModified, size, definition.isValid() ? definition.name() : QString()});
+        if (detection != _syntaxDetection || !definition.isValid()) {
+            return;
+        }
+        _syntaxHighlightDefinition = definition;
+        syntaxHighlightDefinition();
+        updateSyntaxHighlighting(true);
+        loadSyntaxHighlightingCache();
+    });
+    watcher->setFuture(QtConcurrent::run([snapshot=document()->snapshot()] {
+        const int lineCount = snapshot.lineCount();
+        QStringList head;
+        for (int line = 0; line < std::min(lineCount, syntaxDetectHeadLines); line++) {
+            head.append(snapshot.line(line).left(syntaxDetectMaxLineLength));
+        }
+        QStringList tail;
+        for (int line = std::max(syntaxDetectHeadLines, lineCount - syntaxDetectTailLines); line < lineCount; line++) {
+            tail.append(snapshot.line(line).left(syntaxDetectMaxLineLength));
+        }
+        return detectSyntaxHint(head, tail);
+    }));
+}
+
+void File::configureSyntaxHighlighters() {
+    _syntaxHighlightExporter.setFormatTable(_syntaxFormatTable);
+    // The exporter used for painting shares the lock with the background jobs of all windows.
+    const std::shared_ptr<const SyntaxDefinitionLock> definitionLock = syntaxDefinitionLock(_syntaxHighlightDefinition);
+    _syntaxHighlightExporter.setDefinition(_syntaxHighlightDefinition);
+    _syntaxHighlightExporter.setDefinitionLock(definitionLock);
+    _syntaxHighlighterPool->configure(_syntaxHighlightDefinition, definitionLock);
+    _syntaxHighlightStyles.clear();
+}
+
+Tui::ZTextStyle File::syntaxHighlightingStyle(quint16 formatId) {
+    auto it = _syntaxHighlightStyles.constFind(formatId);
+    if (it != _syntaxHighlightStyles.constEnd()) {
+        return *it;
+    }
+
+    Tui::ZColor fg = getColor("chr.editFg");
+    Tui::ZColor bg = getColor("chr.editBg");
+    Tui::ZTextAttributes attr;
+    if (std::optional<KSyntaxHighlighting::Format> format = _syntaxFormatTable->format(formatId)) {
+        const KSyntaxHighlighting::Theme &theme = _syntaxHighlightingTheme;
+        if (format->isBold(theme)) {
+            attr |= Tui::ZTextAttribute::Bold;
+        }
+        if (format->isItalic(theme)) {
+            attr |= Tui::ZTextAttribute::Italic;
+        }
+        if (format->isUnderline(theme)) {
+            attr |= Tui::ZTextAttribute::Underline;
+        }
+        if (format->isStrikeThrough(theme)) {
+            attr |= Tui::ZTextAttribute::Strike;
+        }
+        auto convert = [](QColor q) {
+            return Tui::ZColor::fromRgb(q.red(), q.green(), q.blue());
+        };
+        if (format->hasTextColor(theme)) {
+            fg = convert(format->textColor(theme));
+        }
+        if (format->hasBackgroundColor(theme)) {
+            bg = convert(format->backgroundColor(theme));
+        }
+    }
+    Tui::ZTextStyle style(fg, bg, attr);
+    _syntaxHighlightStyles.insert(formatId, style);
+    return style;
+}
+
+void File::scheduleSyntaxHighlightingEviction() {
+    static bool pending = false;
+    if (syntaxHighlightingBudget > 0 && !pending) {
+        pending = true;
+        QTimer::singleShot(0, [] {
+            pending = false;
+            enforceSyntaxHighlightingBudget();
+        });
+    }
+}
+
+void File::enforceSyntaxHighlightingBudget() {
+    if (syntaxHighlightingBudget <= 0) {
+        return;
+    }
+    const auto &files = syntaxHighlightingFiles();
+    qint64 total = 0;
+    for (const File *file: files) {
+        total += file->_syntaxHighlightMemory;
+    }
+    // Documents in background windows give memory back first, the focused one last.
+    for (auto it = files.rbegin(); it != files.rend() && total > syntaxHighlightingBudget; ++it) {
+        const qint64 before = (*it)->_syntaxHighlightMemory;
+        (*it)->evictSyntaxHighlighting(total - syntaxHighlightingBudget);
+        total -= before - (*it)->_syntaxHighlightMemory;
+    }
+}
+
+void File::evictSyntaxHighlighting(qint64 bytesToFree) {
+    // Lines near the viewport keep their ranges, eviction starts with the lines farthest away from it.
+    const int margin = std::max(100, geometry().height() * 2);
+    const int keepStart = scrollPositionLine() - margin;
+    const int keepEnd = scrollPositionLine() + geometry().height() + margin;
+
+    auto evictLine = [&](int line) -> qint64 {
+        auto data = std::static_pointer_cast<const ExtraData>(document()->lineUserData(line));
+        if (!data || data->evicted || data->cached || data->formats.isEmpty()) {
+            // Cached ranges can not be rebuilt without the states.
+            return 0;
+        }
+        if (document()->lineCodeUnits(line) > _syntaxHighlightPaintRate * syntaxHighlightingPaintBudget) {
+            // Could not be rebuilt within the paint budget.
+            return 0;
+        }
+        auto evicted = std::make_shared<ExtraData>();
+        evicted->stateBegin = data->stateBegin;
+        evicted->stateEnd = data->stateEnd;
+        evicted->lineRevision = data->lineRevision;
+        evicted->partial = data->partial;
+        evicted->evicted = true;
+        document()->setLineUserData(line, evicted);
+        return data->formats.memoryUsage();
+    };
+
+    if (!_syntaxEvictLow) {
+        // No line holds ranges that eviction has not looked at yet.
+        _syntaxHighlightMemory = 0;
+        return;
+    }
+
+    // Continues where the last eviction stopped instead of walking the whole document every time.
+    qint64 freed = 0;
+    int low = _syntaxEvictLow->line();
+    int high = std::min(_syntaxEvictHigh->line(), document()->lineCount() - 1);
+    while (freed < bytesToFree && (low < keepStart || high > keepEnd) && low <= high) {
+        if (low < keepStart && (high <= keepEnd || keepStart - low >= high - keepEnd)) {
+            freed += evictLine(low++);
+        } else {
+            freed += evictLine(high--);
+        }
+    }
+
+    if (freed < bytesToFree) {
+        // Only the lines near the viewport are left. Count them again, the running total also still contains
+        // lines that have been deleted in the meantime.
+        _syntaxHighlightMemory = 0;
+        for (int line = std::max(0, low); line <= high; line++) {
+            if (auto data = std::static_pointer_cast<const ExtraData>(document()->lineUserData(line))) {
+                _syntaxHighlightMemory += syntaxRunsMemory(*data);
+            }
+        }
+    } else {
+        _syntaxHighlightMemory = std::max<qint64>(0, _syntaxHighlightMemory - freed);
+    }
+
+    if (low <= high) {
+        _syntaxEvictLow->setLine(low);
+        _syntaxEvictHigh->setLine(high);
+    } else {
+        _syntaxEvictLow.reset();
+        _syntaxEvictHigh.reset();
+    }
+}
+
+void File::syntaxHighlightingStored(int line) {
+    if (!_syntaxEvictLow) {
+        _syntaxEvictLow.emplace(document(), line);
+        _syntaxEvictHigh.emplace(document(), line);
+        return;
+    }
+    if (line < _syntaxEvictLow->line()) {
+        _syntaxEvictLow->setLine(line);
+    }
+    if (line > _syntaxEvictHigh->line()) {
+        _syntaxEvictHigh->setLine(line);
+    }
+}
+
+void File::loadSyntaxHighlightingCache() {
+    _syntaxHighlightCacheWritten = false;
+    if (syntaxHighlightingCacheBytes <= 0 || _attributesFile.isEmpty() || !_syntaxHighlightDefinition.isValid()
+            || document()->lineCount() < syntaxHighlightingCacheMinLines) {
+        return;
+    }
+
+    SyntaxHighlightingSignalForwarder *forwarder = new SyntaxHighlightingSignalForwarder();
+    forwarder->moveToThread(nullptr); // enable later pull to worker thread
+    QObject::connect(forwarder, &SyntaxHighlightingSignalForwarder::updates, this, &File::ingestSyntaxHighlightingUpdates);
+
+    QtConcurrent::run([forwarder, snapshot=document()->snapshot(), filename=getFilename(),
+                      cache=HighlightCache(QFileInfo(_attributesFile).absolutePath() + "/highlight", syntaxHighlightingCacheBytes),
+                      key=syntaxHighlightingCacheKey(_syntaxHighlightDefinition),
+                      formatsByName=syntaxFormatsByName(_syntaxHighlightDefinition), formatTable=_syntaxFormatTable,
+                      generation=_syntaxHighlightGeneration->load()] {
+        forwarder->moveToThread(QThread::currentThread());
+
+        const std::optional<HighlightCacheEntry> entry = cache.read(filename, key);
+        if (entry) {
+            // Index in entry->formats to format id, -1 for formats the definition does not have anymore.
+            QVector<int> formatIds;
+            for (const QString &name: entry->formats) {
+                auto it = formatsByName.constFind(name);
+                if (it != formatsByName.constEnd()) {
+                    formatTable->add(*it);
+                    formatIds.append(it->id());
+                } else {
+                    formatIds.append(-1);
+                }
+            }
+
+            Updates updates;
+            updates.documentRevision = snapshot.revision();
+            updates.documentLineCount = snapshot.lineCount();
+            updates.generation = generation;
+
+            // Only lines with the same text as when the entry was written are used.
+            const int lineCount = std::min(snapshot.lineCount(), entry->lineHashes.size());
+            for (int line = 0; line < lineCount && snapshot.isUpToDate(); line++) {
+                if (!entry->lineHashes[line]) {
+                    continue;
+                }
+                const QString text = snapshot.line(line);
+                if (HighlightCache::lineHash(text) != entry->lineHashes[line]) {
+                    continue;
+                }
+                auto data = std::make_shared<ExtraData>();
+                const SyntaxRuns &runs = entry->runs[line];
+                bool valid = true;
+                for (int i = 0; i < runs.size() && valid; i++) {
+                    const SyntaxFormatRange range = runs.at(i);
+                    valid = range.formatId < formatIds.size() && formatIds[range.formatId] >= 0;
+                    if (valid) {
+                        data->formats.append(range.offset, range.length, formatIds[range.formatId]);
+                    }
+                }
+                if (!valid) {
+                    continue;
+                }
+                data->formats.squeeze();
+                data->lineRevision = snapshot.lineRevision(line);
+                data->cached = true;
+                updates.data.append(data);
+                updates.lines.append(line);
+                updates.texts.append(text);
+
+                if (updates.data.size() >= 1000) {
+                    forwarder->updates(updates);
+                    updates.data.clear();
+                    updates.lines.clear();
+                    updates.texts.clear();
+                }
+            }
+            if (updates.data.size()) {
+                forwarder->updates(updates);
+            }
+        }
+        delete forwarder;
+    });
+}
+
+void File::writeSyntaxHighlightingCache() {
+    // Only the highlighting of the file as it is on disk is useful when opening it again.
+    if (_syntaxHighlightCacheWritten || syntaxHighlightingCacheBytes <= 0 || _attributesFile.isEmpty()
+            || isModified() || isNewFile() || _stdin || isReadOnlyView()
+            || document()->lineCount() < syntaxHighlightingCacheMinLines) {
+        return;
+    }
+    _syntaxHighlightCacheWritten = true;
+
+    QHash<quint16, QString> formatNames;
+    const QHash<QString, KSyntaxHighlighting::Format> formatsByName = syntaxFormatsByName(_syntaxHighlightDefinition);
+    for (auto it = formatsByName.constBegin(); it != formatsByName.constEnd(); ++it) {
+        formatNames.insert(it->id(), it.key());
+    }
+
+    QtConcurrent::run([snapshot=document()->snapshot(), filename=getFilename(),
+                      cache=HighlightCache(QFileInfo(_attributesFile).absolutePath() + "/highlight", syntaxHighlightingCacheBytes),
+                      key=syntaxHighlightingCacheKey(_syntaxHighlightDefinition), formatNames]() mutable {
+        HighlightCacheEntry entry;
+        entry.definition = key;
+        // Format id to index in entry.formats
+        QHash<quint16, int> formatIndexes;
+
+        const int lineCount = snapshot.lineCount();
+        entry.lineHashes.resize(lineCount);
+        entry.runs.resize(lineCount);
+        for (int line = 0; line < lineCount; line++) {
+            if (!snapshot.isUpToDate()) {
+                return;
+            }
+            auto data = std::static_pointer_cast<const ExtraData>(snapshot.lineUserData(line));
+            if (!data || data->evicted || data->cached || data->lineRevision != snapshot.lineRevision(line)) {
+                continue;
+            }
+            SyntaxRuns runs;
+            bool valid = true;
+            for (int i = 0; i < data->formats.size() && valid; i++) {
+                const SyntaxFormatRange range = data->formats.at(i);
+                int index = formatIndexes.value(range.formatId, -1);
+                if (index < 0) {
+                    valid = formatNames.contains(range.formatId);
+                    if (valid) {
+                        index = entry.formats.size();
+                        entry.formats.append(formatNames.value(range.formatId));
+                        formatIndexes.insert(range.formatId, index);
+                    }
+                }
+                if (valid) {
+                    runs.append(range.offset, range.length, index);
+                }
+            }
+            if (valid) {
+                entry.lineHashes[line] = HighlightCache::lineHash(snapshot.line(line));
+                entry.runs[line] = runs;
+            }
+        }
+        cache.write(filename, entry);
+    });
+}
+
+void File::appendSyntaxHighlights(QVector<Tui::ZFormatRange> &highlights, const SyntaxRuns &formats) {
+    for (int i = 0; i < formats.size(); i++) {
+        const SyntaxFormatRange range = formats.at(i);
+        const Tui::ZTextStyle style = syntaxHighlightingStyle(range.formatId);
+        highlights.append(Tui::ZFormatRange(range.offset, range.length, style,
+                                            {Tui::Colors::darkGray, style.backgroundColor()}, FR_UD_SYNTAX));
+    }
+}
+
 void File::ingestSyntaxHighlightingUpdates(Updates updates) {
-    if (updates.documentRevision != document()->revision()) {
-        // Lines numbers might have changed (by insertion or deletion of lines), we can't use this update
+    if (updates.generation != *_syntaxHighlightGeneration) {
+        // Highlighted with an old definition
         return;
     }
 
+    // When the document was edited while the job was running, lines in front of the edit still have the same
+    // line number and lines after it are shifted by the number of inserted or removed lines. Lines that are
+    // found unchanged at one of these places get their highlighting, all others are left to the next job.
+    const bool sameRevision = updates.documentRevision == document()->revision();
+    const int lineCount = document()->lineCount();
+    const int shift = lineCount - updates.documentLineCount;
+
+    auto unchangedAt = [&](int i, int line) {
+        return 0 <= line && line < lineCount && document()->lineRevision(line) == updates.data[i]->lineRevision
+                && (sameRevision || document()->line(line) == updates.texts[i]);
+    };
+
     const int visibleLinesStart = scrollPositionLine();
     const int visibleLinesEnd = visibleLinesStart + geometry().height();
 
     bool needRepaint = false;
 
     for (int i = 0; i < updates.lines.size(); i++) {
-        const int line = updates.lines[i];
+        int line = updates.lines[i];
 
-        if (line < document()->lineCount() && document()->lineRevision(line) == updates.data[i]->lineRevision) {
-            document()->setLineUserData(line, updates.data[i]);
+        if (!unchangedAt(i, line)) {
+            if (sameRevision || shift == 0 || !unchangedAt(i, line + shift)) {
+                continue;
+            }
+            line += shift;
+        }
 
-            if (visibleLinesStart <= line && line <= visibleLinesEnd) {
-                needRepaint = true;
+        if (auto previous = std::static_pointer_cast<const ExtraData>(document()->lineUserData(line))) {
+            if (updates.data[i]->cached && !previous->cached && previous->lineRevision == document()->lineRevision(line)) {
+                // Already highlighted, that is more accurate than the cache.
+                continue;
             }
+            _syntaxHighlightMemory -= syntaxRunsMemory(*previous);
+        }
+        _syntaxHighlightMemory += syntaxRunsMemory(*updates.data[i]);
+        document()->setLineUserData(line, updates.data[i]);
+        syntaxHighlightingStored(line);
+
+        if (visibleLinesStart <= line && line <= visibleLinesEnd) {
+            needRepaint = true;
         }
     }
+    _syntaxHighlightMemory = std::max<qint64>(0, _syntaxHighlightMemory);
+    scheduleSyntaxHighlightingEviction();
+
+    if (updates.complete && sameRevision) {
+        _syntaxHighlightDirtyLine = std::numeric_limits<int>::max();
+        _syntaxHighlightAppendLine = -1;
+        writeSyntaxHighlightingCache();
+    } else if (updates.complete && _syntaxHighlightAppendLine >= 0) {
+        // Lines were appended while the job ran. Everything in front of the last line it saw is done, even while
+        // new lines keep arriving the next job does not have to start further up.
+        _syntaxHighlightAppendLine = std::max(_syntaxHighlightAppendLine, updates.documentLineCount - 1);
+    }
 
     if (needRepaint) {
         update();
     }
 }
 
-std::tuple<KSyntaxHighlighting::State, QVector<Tui::ZFormatRange>> HighlightExporter::highlightLineWrap(const QString &text,
-                                                                                                        const KSyntaxHighlighting::State &state) {
-    std::lock_guard lock{mutex};
+void SyntaxFormatTable::add(const KSyntaxHighlighting::Format &format) {
+    std::lock_guard lock{_mutex};
+    _formats.insert(format.id(), format);
+}
+
+std::optional<KSyntaxHighlighting::Format> SyntaxFormatTable::format(quint16 id) const {
+    std::lock_guard lock{_mutex};
+    auto it = _formats.constFind(id);
+    if (it == _formats.constEnd()) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+std::tuple<KSyntaxHighlighting::State, SyntaxRuns> HighlightExporter::highlightLineWrap(const QString &text,
+                                                                                         const KSyntaxHighlighting::State &state,
+                                                                                         int maxLength) {
+    auto highlight = [&] {
+        return highlightUnlocked(text, state, maxLength);
+    };
+    return definitionLock ? definitionLock->run(highlight) : highlight();
+}
+
+std::optional<std::tuple<KSyntaxHighlighting::State, SyntaxRuns>> HighlightExporter::tryHighlightLineWrap(
+        const QString &text, const KSyntaxHighlighting::State &state, int maxLength) {
+    auto highlight = [&] {
+        return highlightUnlocked(text, state, maxLength);
+    };
+    if (!definitionLock) {
+        return highlight();
+    }
+    return definitionLock->tryRun(highlight);
+}
+
+std::tuple<KSyntaxHighlighting::State, SyntaxRuns> HighlightExporter::highlightUnlocked(const QString &text,
+                                                                                         const KSyntaxHighlighting::State &state,
+                                                                                         int maxLength) {
     highlights.clear();
-    auto newState = highlightLine(text, state);
-    return {newState, this->highlights};
+    // The state after a cut off line is only a guess, the following lines might be highlighted wrongly.
+    auto newState = highlightLine(text.size() > maxLength ? text.left(maxLength) : text, state);
+    // highlights is reused as buffer for the next line, the result gets an allocation of exactly its size.
+    SyntaxRuns result = highlights;
+    result.squeeze();
+    return {newState, result};
 }
 
-void HighlightExporter::applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format) {
-    Tui::ZTextAttributes attr;
-    if (format.isBold(theme())) {
-        attr |= Tui::ZTextAttribute::Bold;
+KSyntaxHighlighting::State SyntaxStateCache::deduplicate(const KSyntaxHighlighting::State &state) {
+    for (const KSyntaxHighlighting::State &recent: _recent) {
+        if (recent == state) {
+            return recent;
+        }
     }
-    if (format.isItalic(theme())) {
-        attr |= Tui::ZTextAttribute::Italic;
+    _recent[_next] = state;
+    _next = (_next + 1) % _recent.size();
+    return state;
+}
+
+void HighlightExporter::setFormatTable(std::shared_ptr<SyntaxFormatTable> formatTable) {
+    if (this->formatTable != formatTable) {
+        this->formatTable = formatTable;
+        knownFormats.clear();
     }
-    if (format.isUnderline(theme())) {
-        attr |= Tui::ZTextAttribute::Underline;
+}
+
+void HighlightExporter::setDefinitionLock(std::shared_ptr<const SyntaxDefinitionLock> definitionLock) {
+    this->definitionLock = definitionLock;
+}
+
+HighlighterPool::HighlighterPool(std::shared_ptr<SyntaxFormatTable> formatTable)
+    : _formatTable(formatTable)
+{
+}
+
+void HighlighterPool::configure(const KSyntaxHighlighting::Definition &definition,
+                                std::shared_ptr<const SyntaxDefinitionLock> definitionLock) {
+    std::lock_guard lock{_mutex};
+    _definition = definition;
+    _definitionLock = definitionLock;
+    // Instances that are leased right now are reconfigured when they are acquired the next time.
+    _configRevision++;
+}
+
+HighlighterPool::Lease HighlighterPool::acquire() {
+    std::lock_guard lock{_mutex};
+    std::unique_ptr<HighlightExporter> highlighter;
+    if (_idle.size()) {
+        highlighter = std::move(_idle.back());
+        _idle.pop_back();
+    } else {
+        highlighter = std::make_unique<HighlightExporter>();
+        highlighter->setFormatTable(_formatTable);
     }
-    if (format.isStrikeThrough(theme())) {
-        attr |= Tui::ZTextAttribute::Strike;
+    if (highlighter->configRevision != _configRevision) {
+        highlighter->setDefinition(_definition);
+        highlighter->setDefinitionLock(_definitionLock);
+        highlighter->configRevision = _configRevision;
     }
-    auto convert = [](QColor q) {
-        return Tui::ZColor::fromRgb(q.red(), q.green(), q.blue());
-    };
-    Tui::ZColor fg = format.hasTextColor(theme()) ? convert(format.textColor(theme())) : defFg;
-    Tui::ZColor bg = format.hasBackgroundColor(theme()) ? convert(format.backgroundColor(theme())) : defBg;
-    Tui::ZTextStyle style(fg, bg, attr);
-    highlights.append(Tui::ZFormatRange(offset, length, style, {Tui::Colors::darkGray, bg}, FR_UD_SYNTAX));
+    return Lease(highlighter.release(), [this](HighlightExporter *highlighter) {
+        std::lock_guard lock{_mutex};
+        _idle.emplace_back(highlighter);
+    });
+}
+
+void HighlightExporter::applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format) {
+    if (!knownFormats.contains(format.id())) {
+        knownFormats.insert(format.id());
+        if (formatTable) {
+            formatTable->add(format);
+        }
+    }
+    highlights.append(offset, length, format.id());
 }
 #endif
 
+void File::syntaxHighlightingAppended(int line, unsigned revisionBefore) {
+#ifdef SYNTAX_HIGHLIGHTING
+    const bool appendOnly = _syntaxHighlightAppendLine >= 0
+            ? _syntaxHighlightAppendRevision == revisionBefore
+            : _syntaxHighlightDirtyLine == std::numeric_limits<int>::max() && !_syntaxHighlightSweepPending
+              && !_syntaxHighlightSweepTimer->isActive();
+    if (appendOnly) {
+        _syntaxHighlightAppendLine = _syntaxHighlightAppendLine >= 0 ? std::min(_syntaxHighlightAppendLine, line) : line;
+        _syntaxHighlightAppendRevision = document()->revision();
+    } else {
+        _syntaxHighlightAppendLine = -1;
+    }
+    _syntaxHighlightDirtyLine = std::min(_syntaxHighlightDirtyLine, line);
+#else
+    (void)line;
+    (void)revisionBefore;
+#endif
+}
+
 void File::setSyntaxHighlightingTheme(QString themeName) {
 #ifdef SYNTAX_HIGHLIGHTING
     _syntaxHighlightingThemeName = themeName;
-    _syntaxHighlightingTheme = _syntaxHighlightRepo.theme(_syntaxHighlightingThemeName);
-    _syntaxHighlightExporter.setTheme(_syntaxHighlightingTheme);
-    _syntaxHighlightExporter.defBg = getColor("chr.editBg");
-    _syntaxHighlightExporter.defFg = getColor("chr.editFg");
-    for (int line = 0; line < document()->lineCount(); line++) {
-        document()->setLineUserData(line, nullptr);
-    }
-    updateSyntaxHighlighting(true);
+    _syntaxHighlightingTheme = syntaxRepository().theme(_syntaxHighlightingThemeName);
+    // The stored highlights do not depend on the theme, repainting is enough.
+    configureSyntaxHighlighters();
+    updateSyntaxHighlighting(false);
+    update();
 #else
     (void)themeName;
 #endif
@@ -259,7 +1109,9 @@ void File::setSyntaxHighlightingTheme(QString themeName) {
 
 void File::setSyntaxHighlightingLanguage(QString language) {
 #ifdef SYNTAX_HIGHLIGHTING
-    _syntaxHighlightDefinition = _syntaxHighlightRepo.definitionForName(language);
+    // chosen by the user, a running detection must not replace it
+    _syntaxDetection++;
+    _syntaxHighlightDefinition = syntaxRepository().definitionForName(language);
     syntaxHighlightDefinition();
     // rehighlight
     updateSyntaxHighlighting(true);
@@ -272,8 +1124,49 @@ QString File::syntaxHighlightingLanguage() {
     return _syntaxHighlightingLanguage;
 }
 
-bool File::syntaxHighlightingActive() {
-    return _syntaxHighlightingActive;
+bool File::syntaxHighlightingActive() {
+    return _syntaxHighlightingActive;
+}
+
+SyntaxHighlightingCounters File::syntaxHighlightingCounters() const {
+    return _syntaxHighlightingCounters;
+}
+
+qint64 File::syntaxHighlightingMemoryUsage() const {
+    return _syntaxHighlightMemory;
+}
+
+void File::setSyntaxHighlightingMemoryBudget(qint64 bytes) {
+#ifdef SYNTAX_HIGHLIGHTING
+    syntaxHighlightingBudget = bytes;
+    enforceSyntaxHighlightingBudget();
+#else
+    (void)bytes;
+#endif
+}
+
+qint64 File::syntaxHighlightingMemoryBudget() {
+#ifdef SYNTAX_HIGHLIGHTING
+    return syntaxHighlightingBudget;
+#else
+    return 0;
+#endif
+}
+
+void File::setSyntaxHighlightingCacheSize(qint64 bytes) {
+#ifdef SYNTAX_HIGHLIGHTING
+    syntaxHighlightingCacheBytes = bytes;
+#else
+    (void)bytes;
+#endif
+}
+
+qint64 File::syntaxHighlightingCacheSize() {
+#ifdef SYNTAX_HIGHLIGHTING
+    return syntaxHighlightingCacheBytes;
+#else
+    return 0;
+#endif
 }
 
 void File::setSyntaxHighlightingActive(bool active) {
@@ -291,6 +1184,13 @@ void File::setSyntaxHighlightingActive(bool active) {
 }
 
 File::~File() {
+#ifdef SYNTAX_HIGHLIGHTING
+    auto &files = syntaxHighlightingFiles();
+    files.erase(std::remove(files.begin(), files.end(), this), files.end());
+#endif
+    if (_loadingCancel) {
+        *_loadingCancel = true;
+    }
     if (_searchNextFuture) {
         _searchNextFuture->cancel();
         _searchNextFuture.reset();
@@ -301,6 +1201,10 @@ File::~File() {
 
 
 int File::convertTabsToSpaces() {
+    if (isReadOnlyView()) {
+        return 0;
+    }
+
     auto undoGroup = startUndoGroup();
 
     int count = 0;
@@ -383,6 +1287,7 @@ bool File::stdinText() {
     document()->setFilename("STDIN");
     _stdin = true;
     initText();
+    _stdinCodeUnits = 0;
     setFollowStandardInput(true);
     followStandardInputChanged(true);
     modifiedChanged(true);
@@ -391,11 +1296,32 @@ bool File::stdinText() {
 }
 
 bool File::initText() {
+    if (_loadingCancel) {
+        // superseded by the new content, this is not a cancel by the user
+        *_loadingCancel = true;
+        _loadingCancel.reset();
+        _pendingAfterLoading.clear();
+        loadingProgressChanged(-1, -1, 0);
+    }
+    _mappedFile.reset();
+    _pageFirstLine = 0;
+    _pagedRestorePosition.reset();
+    _loadedFileSize = -1;
+    _loadedFileInode = 0;
+#ifdef SYNTAX_HIGHLIGHTING
+    // a running detection was for the old content
+    _syntaxDetection++;
+#endif
     clear();
     return true;
 }
 
 bool File::saveText() {
+    if (isReadOnlyView()) {
+        // The document only contains the currently shown or loaded part of the file.
+        return false;
+    }
+
     // QSaveFile does not take over the user and group. Therefore this should only be used if
     // user and group are the same and the editor also runs under this user.
     QFile file(getFilename());
@@ -403,6 +1329,11 @@ bool File::saveText() {
     if (file.open(QIODevice::WriteOnly)) {
         bool ok = writeTo(&file);
         ok &= file.flush();
+        if (ok) {
+            struct stat st;
+            _loadedFileSize = file.pos();
+            _loadedFileInode = ::fstat(file.handle(), &st) == 0 ? st.st_ino : 0;
+        }
 
         //file.commit();
         file.close();
@@ -414,6 +1345,13 @@ bool File::saveText() {
         checkWritable();
         update();
         writeAttributes();
+#ifdef SYNTAX_HIGHLIGHTING
+        // The file on disk changed, the cache is updated when the highlighting is complete again.
+        _syntaxHighlightCacheWritten = false;
+        if (_syntaxHighlightDirtyLine == std::numeric_limits<int>::max() && !_syntaxHighlightJobRunning) {
+            writeSyntaxHighlightingCache();
+        }
+#endif
         return true;
     }
     //TODO vernünfiges error Händling
@@ -425,6 +1363,10 @@ void File::checkWritable() {
 }
 
 bool File::getWritable() {
+    if (isReadOnlyView()) {
+        return false;
+    }
+
     QFileInfo file(getFilename());
     if (file.isWritable()) {
         return true;
@@ -453,10 +1395,15 @@ bool File::highlightBracket() {
 }
 
 bool File::writeAttributes() {
+    if (isLoading()) {
+        // The cursor position of the empty document would overwrite the stored one.
+        return false;
+    }
     Attributes a{_attributesFile};
+    const auto [cursorCodeUnit, cursorLine] = cursorPosition();
     return a.writeAttributes(getFilename(),
-                             cursorPosition(),
-                             scrollPositionColumn(), scrollPositionLine(), scrollPositionFineLine(),
+                             {cursorCodeUnit, _pageFirstLine + cursorLine},
+                             scrollPositionColumn(), _pageFirstLine + scrollPositionLine(), scrollPositionFineLine(),
                              _lineMarker->listMarker());
 }
 
@@ -468,55 +1415,369 @@ QString File::attributesFile() {
     return _attributesFile;
 }
 
+void File::setPagedViewThreshold(qint64 bytes) {
+    _pagedViewThreshold = bytes;
+}
+
+qint64 File::pagedViewThreshold() const {
+    return _pagedViewThreshold;
+}
+
+bool File::isPaged() const {
+    return _mappedFile != nullptr;
+}
+
+qint64 File::loadedFileSize() const {
+    return _loadedFileSize;
+}
+
+quint64 File::loadedFileInode() const {
+    return _loadedFileInode;
+}
+
+bool File::isLoading() const {
+    return _loadingCancel != nullptr;
+}
+
+bool File::isReadOnlyView() const {
+    return _mappedFile || _loadingCancel;
+}
+
 bool File::openText(QString filename) {
+    if (_pagedViewThreshold > 0 && QFileInfo(filename).size() >= _pagedViewThreshold) {
+        return openPaged(filename);
+    }
+
     setFilename(filename);
+    const std::atomic<bool> cancel = false;
+    LoadedText result = loadText(getFilename(), cancel, {});
+    if (result.tooLarge) {
+        return openTextReadFrom();
+    }
+    if (!result.ok) {
+        return false;
+    }
+
+    initText();
+    applyLoadedText(result, std::nullopt);
+    return true;
+}
+
+bool File::openTextReadFrom() {
     QFile file(getFilename());
-    if (file.open(QIODevice::ReadOnly)) {
-        initText();
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    initText();
 
-        Attributes a{_attributesFile};
-        Tui::ZDocumentCursor::Position initialPosition = a.getAttributesCursorPosition(getFilename());
-        const bool ok = readFrom(&file, initialPosition);
-        file.close();
+    Attributes a{_attributesFile};
+    if (!readFrom(&file, a.getAttributesCursorPosition(getFilename()))) {
+        return false;
+    }
+    struct stat st;
+    _loadedFileSize = file.pos();
+    _loadedFileInode = ::fstat(file.handle(), &st) == 0 ? st.st_ino : 0;
+    openTextFinished(a);
+    return true;
+}
 
-        if (!ok) {
+bool File::openTextAsync(QString filename, std::optional<Tui::ZDocumentCursor::Position> cursorPosition) {
+    if (_pagedViewThreshold > 0 && QFileInfo(filename).size() >= _pagedViewThreshold) {
+        if (!openPaged(filename)) {
             return false;
         }
+        if (cursorPosition) {
+            _pagedRestorePosition = *cursorPosition;
+            _pagedRestoreScrollLine = cursorPosition->line;
+        }
+        loadingFinished(true);
+        return true;
+    }
 
-        if (getWritable()) {
-            setSaveAs(false);
-        } else {
-            setSaveAs(true);
+    setFilename(filename);
+    if (!QFileInfo(getFilename()).isReadable()) {
+        return false;
+    }
+
+    initText();
+    _lineMarker->clearMarkers();
+    setSaveAs(true);
+    checkWritable();
+    modifiedChanged(false);
+
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    _loadingCancel = cancel;
+    loadingProgressChanged(0, QFileInfo(getFilename()).size(), 0);
+
+    FileLoaderSignalForwarder *fileLoaderSignalForwarder = new FileLoaderSignalForwarder();
+    QObject::connect(fileLoaderSignalForwarder, &FileLoaderSignalForwarder::progress, this,
+                     [this, cancel](qint64 bytesRead, qint64 bytesTotal, int lines) {
+        if (_loadingCancel == cancel) {
+            loadingProgressChanged(bytesRead, bytesTotal, lines);
+        }
+    });
+    QObject::connect(fileLoaderSignalForwarder, &FileLoaderSignalForwarder::finished, this,
+                     [this, cancel, cursorPosition](LoadedText result) {
+        if (_loadingCancel != cancel) {
+            // canceled or replaced by a newer load
+            return;
+        }
+        _loadingCancel.reset();
+        loadingProgressChanged(-1, -1, 0);
+
+        if (result.tooLarge) {
+            // Can only be loaded on the main thread.
+            result.ok = openTextReadFrom();
+            if (result.ok && cursorPosition) {
+                setCursorPosition(*cursorPosition);
+            }
+        } else if (result.ok) {
+            applyLoadedText(result, cursorPosition);
         }
 
-        checkWritable();
+        if (!result.ok) {
+            _pendingAfterLoading.clear();
+            loadingFinished(false);
+            return;
+        }
 
-        modifiedChanged(false);
+        if (_searchText != "") {
+            // restart the search count with the loaded text
+            restartSearch();
+        }
+
+        auto pending = std::move(_pendingAfterLoading);
+        _pendingAfterLoading.clear();
+        for (const auto &action: pending) {
+            action();
+        }
+
+        loadingFinished(true);
+    });
+
+    QtConcurrent::run([fileLoaderSignalForwarder](QString filename, std::shared_ptr<std::atomic<bool>> cancel) {
+        LoadedText result = loadText(filename, *cancel, [fileLoaderSignalForwarder](qint64 bytesRead, qint64 bytesTotal, int lines) {
+            fileLoaderSignalForwarder->progress(bytesRead, bytesTotal, lines);
+        });
+        fileLoaderSignalForwarder->finished(result);
+        fileLoaderSignalForwarder->deleteLater();
+    }, getFilename(), cancel);
+
+    return true;
+}
+
+void File::cancelLoading() {
+    if (!_loadingCancel) {
+        return;
+    }
+    *_loadingCancel = true;
+    _loadingCancel.reset();
+    _pendingAfterLoading.clear();
+    loadingProgressChanged(-1, -1, 0);
+    loadingCanceled();
+}
+
+void File::applyLoadedText(LoadedText &result, std::optional<Tui::ZDocumentCursor::Position> cursorPosition) {
+    setText(result.text);
+    _loadedFileSize = result.bytesRead;
+    _loadedFileInode = result.inode;
+    result.text.clear();
+    document()->setCrLfMode(result.crLfMode);
+    document()->setNewlineAfterLastLineMissing(result.newlineAfterLastLineMissing);
+    document()->markUndoStateAsSaved();
+
+    Attributes a{_attributesFile};
+    if (cursorPosition) {
+        setCursorPosition(*cursorPosition);
+    } else {
+        setCursorPosition(a.getAttributesCursorPosition(getFilename()));
+    }
+    openTextFinished(a);
+}
+
+void File::openTextFinished(Attributes &a) {
+    if (getWritable()) {
+        setSaveAs(false);
+    } else {
+        setSaveAs(true);
+    }
+
+    checkWritable();
+
+    modifiedChanged(false);
+
+    setScrollPosition(a.getAttributesScrollCol(getFilename()),
+                      a.getAttributesScrollLine(getFilename()),
+                      a.getAttributesScrollFine(getFilename()));
+
+    QList lm = a.getAttributesLineMarker(getFilename());
+    _lineMarker->clearMarkers(); // delete all old markers before adding a new one
+    for(int i = 0; i < lm.size(); i++) {
+        _lineMarker->addMarker(document(), lm.at(i));
+    }
+
+    adjustScrollPosition();
+
+#ifdef SYNTAX_HIGHLIGHTING
+    detectSyntaxDefinition();
+    loadSyntaxHighlightingCache();
+#endif
+}
+
+
+bool File::openPaged(QString filename) {
+    setFilename(filename);
+
+    auto mappedFile = std::make_unique<MappedFile>();
+    if (!mappedFile->open(getFilename())) {
+        return false;
+    }
 
-        setScrollPosition(a.getAttributesScrollCol(getFilename()),
-                          a.getAttributesScrollLine(getFilename()),
-                          a.getAttributesScrollFine(getFilename()));
+    initText();
+    _lineMarker->clearMarkers();
+    _mappedFile = std::move(mappedFile);
+    const unsigned generation = ++_mappedFileGeneration;
 
-        QList lm = a.getAttributesLineMarker(getFilename());
-        _lineMarker->clearMarkers(); // delete all old markers before adding a new one
-        for(int i = 0; i < lm.size(); i++) {
-            _lineMarker->addMarker(document(), lm.at(i));
+    QObject::connect(_mappedFile.get(), &MappedFile::indexProgress, this, [this, generation](int lineCount, bool complete) {
+        // Emitted from the index thread, so it can arrive after another file was opened.
+        if (!_mappedFile || generation != _mappedFileGeneration) {
+            return;
         }
+        if (_pagedRestorePosition && (_pagedRestorePosition->line < lineCount || complete)) {
+            const Tui::ZDocumentCursor::Position position = *_pagedRestorePosition;
+            _pagedRestorePosition.reset();
+            pagedShowLine(position, position, _pagedRestoreScrollLine);
+        } else if (document()->lineCount() < pagedWindowLineCount()
+                   && _pageFirstLine + document()->lineCount() < lineCount) {
+            // The index did not cover the whole window yet, add the newly available lines.
+            const Tui::ZDocumentCursor::Position anchor = anchorPosition();
+            const Tui::ZDocumentCursor::Position cursor = cursorPosition();
+            pagedShowLine({anchor.codeUnit, _pageFirstLine + anchor.line}, {cursor.codeUnit, _pageFirstLine + cursor.line},
+                          _pageFirstLine + scrollPositionLine());
+        }
+        // the width of the line numbers might have changed
+        update();
+    });
 
-        adjustScrollPosition();
+    Attributes a{_attributesFile};
+    const Tui::ZDocumentCursor::Position initialPosition = a.getAttributesCursorPosition(getFilename());
+    if (initialPosition.line > 0 || initialPosition.codeUnit > 0) {
+        _pagedRestorePosition = initialPosition;
+        _pagedRestoreScrollLine = a.getAttributesScrollLine(getFilename());
+    }
+
+    setSaveAs(true);
+    checkWritable();
+    modifiedChanged(false);
 
 #ifdef SYNTAX_HIGHLIGHTING
-        _syntaxHighlightDefinition = _syntaxHighlightRepo.definitionForFileName(getFilename());
-        syntaxHighlightDefinition();
+    detectSyntaxDefinition();
 #endif
 
+    return true;
+}
+
+int File::pagedWindowLineCount() const {
+    return std::max(1000, geometry().height() * 8);
+}
+
+void File::pagedShowLine(Tui::ZDocumentCursor::Position absoluteAnchor, Tui::ZDocumentCursor::Position absoluteCursor,
+                         int absoluteScrollLine) {
+    const int totalLines = std::max(1, _mappedFile->lineCount());
+    const int windowLines = pagedWindowLineCount();
+    const int cursorLine = std::clamp(absoluteCursor.line, 0, totalLines - 1);
+    const int firstLine = std::clamp(cursorLine - windowLines / 2, 0, std::max(0, totalLines - windowLines));
+
+    QStringList lines = _mappedFile->lines(firstLine, windowLines);
+    if (lines.isEmpty()) {
+        lines.append(QString());
+    }
+    const int lastLine = firstLine + lines.size() - 1;
+    const bool windowAtEnd = _mappedFile->indexComplete() && lastLine + 1 >= _mappedFile->lineCount();
+
+    auto toWindow = [&](Tui::ZDocumentCursor::Position position) -> Tui::ZDocumentCursor::Position {
+        if (position.line < firstLine) {
+            return {0, 0};
+        }
+        if (position.line > lastLine) {
+            return {static_cast<int>(lines.last().size()), lastLine - firstLine};
+        }
+        const int line = position.line - firstLine;
+        return {std::min(position.codeUnit, static_cast<int>(lines[line].size())), line};
+    };
+
+    _pagedReloading = true;
+    _pageFirstLine = firstLine;
+    setText(lines.join('\n'));
+    document()->setCrLfMode(_mappedFile->crLfMode());
+    document()->setNewlineAfterLastLineMissing(windowAtEnd && _mappedFile->newlineAfterLastLineMissing());
+
+    const Tui::ZDocumentCursor::Position anchor = toWindow(absoluteAnchor);
+    const Tui::ZDocumentCursor::Position cursor = toWindow(absoluteCursor);
+    if (anchor != cursor) {
+        setSelection(anchor, cursor);
+    } else {
+        setCursorPosition(cursor);
+    }
+    setScrollPosition(scrollPositionColumn(),
+                      std::clamp(absoluteScrollLine - firstLine, 0, document()->lineCount() - 1), 0);
+    _pagedReloading = false;
+
+    modifiedChanged(false);
+    update();
+}
+
+void File::pagedCheckWindow() {
+    if (!_mappedFile || _pagedReloading) {
+        return;
+    }
+
+    const int windowLines = document()->lineCount();
+    const int margin = std::max(100, geometry().height() * 2);
+    const bool moreBefore = _pageFirstLine > 0;
+    const bool moreAfter = _pageFirstLine + windowLines < _mappedFile->lineCount();
+
+    if (isDetachedScrolling()) {
+        const int scrollLine = scrollPositionLine();
+        if ((moreBefore && scrollLine < margin) || (moreAfter && scrollLine + geometry().height() >= windowLines - margin)) {
+            // The cursor is not visible, move it along with the shown lines.
+            const Tui::ZDocumentCursor::Position position = {0, _pageFirstLine + scrollLine};
+            pagedShowLine(position, position, _pageFirstLine + scrollLine);
+        }
+    } else {
+        const Tui::ZDocumentCursor::Position anchor = anchorPosition();
+        const Tui::ZDocumentCursor::Position cursor = cursorPosition();
+        if ((moreBefore && cursor.line < margin) || (moreAfter && cursor.line >= windowLines - margin)) {
+            pagedShowLine({anchor.codeUnit, _pageFirstLine + anchor.line}, {cursor.codeUnit, _pageFirstLine + cursor.line},
+                          _pageFirstLine + scrollPositionLine());
+        }
+    }
+}
+
+bool File::pagedIsViewKey(Tui::ZKeyEvent *event) const {
+    if (event->modifiers() & Qt::AltModifier) {
+        // no block selection, its line markers do not survive replacing the shown part of the file
+        return false;
+    }
+    const int key = event->key();
+    if (key == Qt::Key_Left || key == Qt::Key_Right || key == Qt::Key_Up || key == Qt::Key_Down
+            || key == Qt::Key_Home || key == Qt::Key_End || key == Qt::Key_PageUp || key == Qt::Key_PageDown) {
+        return true;
+    }
+    if ((key == Qt::Key_Escape || key == Qt::Key_F4) && event->modifiers() == 0) {
+        return true;
+    }
+    if (event->modifiers() == Qt::ControlModifier && (event->text() == "c" || event->text() == "a")) {
         return true;
     }
     return false;
 }
 
-
 void File::cutline() {
+    if (isReadOnlyView()) {
+        return;
+    }
+
     clearSelection();
     Tui::ZDocumentCursor cursor = textCursor();
     cursor.moveToStartOfLine();
@@ -528,6 +1789,10 @@ void File::cutline() {
 }
 
 void File::deleteLine() {
+    if (isReadOnlyView()) {
+        return;
+    }
+
     Tui::ZDocumentCursor cursor = textCursor();
     auto undoGroup = document()->startUndoGroup(&cursor);
     if (cursor.hasSelection() || hasBlockSelection() || hasMultiInsert()) {
@@ -574,6 +1839,10 @@ void File::copy() {
 }
 
 void File::paste() {
+    if (isReadOnlyView()) {
+        return;
+    }
+
     auto undoGroup = startUndoGroup();
     Tui::ZClipboard *clipboard = findFacet<Tui::ZClipboard>();
     if (clipboard->contents().size()) {
@@ -584,6 +1853,10 @@ void File::paste() {
 }
 
 void File::gotoLine(QString pos) {
+    if (isLoading()) {
+        _pendingAfterLoading.push_back([this, pos] { gotoLine(pos); });
+        return;
+    }
     int lineNumber = -1, lineChar = 0;
     if (pos.mid(0,1) == "+") {
         pos = pos.mid(1);
@@ -595,6 +1868,12 @@ void File::gotoLine(QString pos) {
     if (list1.count() > 1) {
         lineChar = list1[1].toInt() -1;
     }
+    if (_mappedFile) {
+        _pagedRestorePosition.reset();
+        pagedShowLine({lineChar, lineNumber}, {lineChar, lineNumber}, lineNumber);
+        adjustScrollPosition();
+        return;
+    }
     setCursorPosition({lineChar, lineNumber});
 }
 
@@ -690,6 +1969,7 @@ void File::selectLines(int startY, int endY) {
 void File::clearAdvancedSelection() {
     if (_currentSearchMatch) {
         _currentSearchMatch.reset();
+        searchMatchChanged(0);
     }
 
     if (_blockSelect) {
@@ -698,6 +1978,9 @@ void File::clearAdvancedSelection() {
 }
 
 bool File::canCut() {
+    if (isReadOnlyView()) {
+        return false;
+    }
     return hasBlockSelection() || ZTextEdit::hasSelection();
 }
 
@@ -929,6 +2212,10 @@ void File::multiInsertInsert(const QString &text) {
 }
 
 void File::toggleLineMarker() {
+    if (isReadOnlyView()) {
+        // Markers are attached to document lines, which are replaced when the shown part of the file changes.
+        return;
+    }
     if (_lineMarker->hasMarker(cursorPosition().line)) {
         _lineMarker->removeMarker(cursorPosition().line);
     } else {
@@ -955,66 +2242,200 @@ bool File::hasLineMarker() const {
     return _lineMarker->hasMarker();
 }
 
-bool File::hasLineMarker(int line) const {
-    return _lineMarker->hasMarker(line);
+bool File::hasLineMarker(int line) const {
+    return _lineMarker->hasMarker(line);
+}
+
+int File::lineMarkerBorderWidth() const {
+    if (hasLineMarker()) {
+        if (lineNumberBorderWidth() > 0) {
+            return 1;
+        }
+    } else {
+        return 0;
+    }
+    return 2;
+}
+
+int File::lineNumberWidth() const {
+    const int width = lineNumberBorderWidth();
+    if (!_mappedFile || width == 0) {
+        return width;
+    }
+    // lineNumberBorderWidth() only accounts for the lines in the document, but in paged view these
+    // are only a part of the file.
+    const int shownLines = document()->lineCount();
+    const int totalLines = std::max(_mappedFile->lineCount(), _pageFirstLine + shownLines);
+    return width + std::max(0, static_cast<int>(QString::number(totalLines).size() - QString::number(shownLines).size()));
+}
+
+int File::allBordersWidth() const {
+    return lineNumberWidth() + lineMarkerBorderWidth();
+}
+
+void File::setSearchText(QString searchText) {
+    // Called before every search step, the count and index only start over when the search changed.
+    if (searchText == _searchText) {
+        return;
+    }
+    _searchText = searchText;
+    restartSearch();
+}
+
+void File::restartSearch() {
+    ++(*searchGeneration);
+    _searchIndex.reset();
+    _searchIndexUpdatePending = false;
+    searchTextChanged(_searchText);
+    searchMatchChanged(0);
+    updateSearchMarks();
+
+    if (_searchText == "") {
+        _cmdSearchNext->setEnabled(false);
+        _cmdSearchPrevious->setEnabled(false);
+        setSearchVisible(false);
+        return;
+    } else {
+        _cmdSearchNext->setEnabled(true);
+        _cmdSearchPrevious->setEnabled(true);
+        setSearchVisible(true);
+    }
+
+    searchCountChanged(0, false);
+    startSearchCount(nullptr);
+}
+
+void File::startSearchCount(std::shared_ptr<const SearchIndex> previous) {
+    const int gen = *searchGeneration;
+    _searchIndexJobs++;
+
+    SearchCountSignalForwarder *searchCountSignalForwarder = new SearchCountSignalForwarder();
+    QObject::connect(searchCountSignalForwarder, &SearchCountSignalForwarder::searchCount, this, &File::searchCountChanged);
+    QObject::connect(searchCountSignalForwarder, &SearchCountSignalForwarder::searchIndex, this, &File::ingestSearchIndex);
+
+    QtConcurrent::run([searchCountSignalForwarder](Tui::ZDocumentSnapshot snap, std::shared_ptr<const SearchIndex> previous, QString searchText, Qt::CaseSensitivity caseSensitivity, bool regex, int gen, std::shared_ptr<std::atomic<int>> searchGen) {
+        SearchCount sc;
+        QObject::connect(&sc, &SearchCount::searchCount, searchCountSignalForwarder, &SearchCountSignalForwarder::searchCount);
+        QObject::connect(&sc, &SearchCount::searchIndex, searchCountSignalForwarder, &SearchCountSignalForwarder::searchIndex);
+        if (previous) {
+            sc.update(snap, previous, searchText, caseSensitivity, regex, gen, searchGen);
+        } else {
+            sc.run(snap, searchText, caseSensitivity, regex, gen, searchGen);
+        }
+        searchCountSignalForwarder->deleteLater();
+    }, document()->snapshot(), previous, _searchText, _searchCaseSensitivity, _searchRegex, gen, searchGeneration);
+}
+
+void File::ingestSearchIndex(std::shared_ptr<const SearchIndex> index) {
+    _searchIndexJobs--;
+    if (index && index->generation == *searchGeneration) {
+        _searchIndex = index;
+        updateSearchMatchNumber();
+        updateSearchMarks();
+    }
+    // Catches up with changes made while the jobs ran, the index is for the revision of their snapshot.
+    if (!_searchIndexJobs && (std::exchange(_searchIndexUpdatePending, false) || !searchIndexValid())) {
+        updateSearchIndex();
+    }
+}
+
+void File::updateSearchIndex() {
+    if (_searchIndexJobs) {
+        // All changes until the running job finishes are indexed together afterwards, this includes the first
+        // job that builds the index.
+        _searchIndexUpdatePending = true;
+        return;
+    }
+    // Without an index (e.g. too many matches) the count is not updated on changes either.
+    if (!_searchIndex || _searchIndex->generation != *searchGeneration
+            || _searchIndex->documentRevision == document()->revision()) {
+        return;
+    }
+    startSearchCount(_searchIndex);
+}
+
+bool File::searchIndexValid() const {
+    return _searchIndex && _searchIndex->generation == *searchGeneration
+            && _searchIndex->documentRevision == document()->revision();
+}
+
+static bool positionBefore(const Tui::ZDocumentCursor::Position &a, const Tui::ZDocumentCursor::Position &b) {
+    return a.line < b.line || (a.line == b.line && a.codeUnit < b.codeUnit);
 }
 
-int File::lineMarkerBorderWidth() const {
-    if (hasLineMarker()) {
-        if (lineNumberBorderWidth() > 0) {
-            return 1;
+void File::selectSearchMatch(Tui::ZDocumentCursor::Position anchor, Tui::ZDocumentCursor::Position cursor, bool forward,
+                             std::variant<std::monostate, Tui::ZDocumentFindAsyncResult, Tui::ZDocumentFindResult> match) {
+    clearAdvancedSelection();
+
+    if (selectMode()) {
+        if (forward) {
+            setCursorPosition(cursor, true);
+        } else {
+            setCursorPosition(anchor, true);
         }
     } else {
-        return 0;
+        setSelection(anchor, cursor);
     }
-    return 2;
-}
 
-int File::allBordersWidth() const {
-    return lineNumberBorderWidth() + lineMarkerBorderWidth();
-}
+    _currentSearchMatch.emplace(match);
+    updateSearchMatchNumber();
 
-void File::setSearchText(QString searchText) {
-    int gen = ++(*searchGeneration);
-    _searchText = searchText;
-    searchTextChanged(_searchText);
+    updateCommands();
 
-    if (searchText == "") {
-        _cmdSearchNext->setEnabled(false);
-        _cmdSearchPrevious->setEnabled(false);
-        setSearchVisible(false);
-        return;
-    } else {
-        _cmdSearchNext->setEnabled(true);
-        _cmdSearchPrevious->setEnabled(true);
-        setSearchVisible(true);
-    }
+    const auto [currentCodeUnit, currentLine] = cursorPosition();
 
-    if (_searchRegex || _searchText.contains('\n')) {
-        // SearchCount currently does not support regular expression and does not support multi line matches,
-        // just disable the search count display in these cases for now.
-        searchCountChanged(-1);
-    } else {
-        SearchCountSignalForwarder *searchCountSignalForwarder = new SearchCountSignalForwarder();
-        QObject::connect(searchCountSignalForwarder, &SearchCountSignalForwarder::searchCount, this, &File::searchCountChanged);
+    setScrollPosition(scrollPositionColumn(), std::max(0, currentLine - 1), 0);
+    adjustScrollPosition();
+}
+
+void File::updateSearchMatchNumber() {
+    int number = 0;
+    if (_currentSearchMatch && searchIndexValid()) {
+        const Tui::ZDocumentCursor::Position start = textCursor().selectionStartPos();
+        const QVector<SearchMatch> &matches = _searchIndex->matches;
+        auto it = std::lower_bound(matches.begin(), matches.end(), start,
+                                   [](const SearchMatch &match, const Tui::ZDocumentCursor::Position &pos) {
+            return positionBefore(match.start, pos);
+        });
+        if (it != matches.end() && !positionBefore(start, it->start)) {
+            number = it - matches.begin() + 1;
+        }
+    }
+    searchMatchChanged(number);
+}
 
-        QtConcurrent::run([searchCountSignalForwarder](Tui::ZDocumentSnapshot snap, QString searchText, Qt::CaseSensitivity caseSensitivity, int gen, std::shared_ptr<std::atomic<int>> searchGen) {
-            SearchCount sc;
-            QObject::connect(&sc, &SearchCount::searchCount, searchCountSignalForwarder, &SearchCountSignalForwarder::searchCount);
-            sc.run(snap, searchText, caseSensitivity, gen, searchGen);
-            searchCountSignalForwarder->deleteLater();
-        }, document()->snapshot(), _searchText, _searchCaseSensitivity, gen, searchGeneration);
+void File::updateSearchMarks() {
+    QVector<double> marks;
+    if (searchVisible() && _searchIndex && _searchIndex->generation == *searchGeneration) {
+        // No scroll bar has more rows than this, so a mark for each of these parts of the document is enough.
+        const int resolution = 1000;
+        const double lineCount = std::max(1, _searchIndex->lineRevisions.size());
+        int lastPart = -1;
+        for (const SearchMatch &match: _searchIndex->matches) {
+            const int part = static_cast<int>(match.start.line / lineCount * resolution);
+            if (part != lastPart) {
+                marks.append(match.start.line / lineCount);
+                lastPart = part;
+            }
+        }
     }
+    searchMarksChanged(marks);
 }
 
 void File::setSearchCaseSensitivity(Qt::CaseSensitivity searchCaseSensitivity) {
+    const bool changed = _searchCaseSensitivity != searchCaseSensitivity;
     _searchCaseSensitivity = searchCaseSensitivity;
+    if (changed && _searchText.size()) {
+        // restart the search count
+        restartSearch();
+    }
     update();
 }
 
 void File::setSearchVisible(bool visible) {
     _searchVisible = visible;
     searchVisibleChanged(visible);
+    updateSearchMarks();
     update();
 }
 
@@ -1022,6 +2443,56 @@ bool File::searchVisible() {
     return _searchVisible;
 }
 
+const QVector<QPair<int, int>> &File::searchMatchesInLine(int line) {
+    // Every change of the search text, case sensitivity or regex mode goes through restartSearch.
+    const int gen = *searchGeneration;
+    if (_searchMatchGeneration != gen) {
+        _searchMatchGeneration = gen;
+        _searchMatchCache.clear();
+        _searchMatchRegex = QRegularExpression();
+        if (_searchRegex) {
+            _searchMatchRegex.setPattern(_searchText);
+            if (_searchCaseSensitivity == Qt::CaseInsensitive) {
+                _searchMatchRegex.setPatternOptions(QRegularExpression::PatternOption::CaseInsensitiveOption);
+            }
+            _searchMatchRegex.optimize();
+        }
+    }
+
+    const unsigned revision = document()->lineRevision(line);
+    auto it = _searchMatchCache.find(line);
+    if (it != _searchMatchCache.end() && it->lineRevision == revision) {
+        return it->matches;
+    }
+
+    // Only needs to hold about the visible lines, start over instead of tracking which are still visible.
+    if (_searchMatchCache.size() > 1000) {
+        _searchMatchCache.clear();
+    }
+
+    SearchMatchCacheEntry &entry = _searchMatchCache[line];
+    entry.lineRevision = revision;
+    entry.matches.clear();
+    const QString text = document()->line(line);
+    if (_searchRegex) {
+        if (_searchMatchRegex.isValid()) {
+            QRegularExpressionMatchIterator i = _searchMatchRegex.globalMatch(text);
+            while (i.hasNext()) {
+                QRegularExpressionMatch match = i.next();
+                if (match.capturedLength() > 0) {
+                    entry.matches.append(qMakePair(match.capturedStart(), match.capturedLength()));
+                }
+            }
+        }
+    } else {
+        int found = -1;
+        while ((found = text.indexOf(_searchText, found + 1, _searchCaseSensitivity)) != -1) {
+            entry.matches.append(qMakePair(found, _searchText.size()));
+        }
+    }
+    return entry.matches;
+}
+
 void File::setReplaceText(QString replaceText) {
     _replaceText = replaceText;
 }
@@ -1031,7 +2502,12 @@ bool File::isSearchMatchSelected() {
 }
 
 void File::setRegex(bool reg) {
+    const bool changed = _searchRegex != reg;
     _searchRegex = reg;
+    if (changed && _searchText.size()) {
+        // restart the search count
+        restartSearch();
+    }
 }
 void File::setSearchWrap(bool wrap) {
     _searchWrap = wrap;
@@ -1054,8 +2530,133 @@ void File::setFollowStandardInput(bool follow) {
     _followMode = follow;
 }
 
+void File::setFollowFile(bool follow) {
+    _followFile = follow;
+    if (follow) {
+        // Start at the end, like tail -f
+        setCursorPosition({0, document()->lineCount() - 1});
+    } else {
+        _followMode = false;
+    }
+}
+
+bool File::followFile() const {
+    return _followFile;
+}
+
+// Replaces \1 to \9 by the captures of the match and \\ by \, other escapes are dropped.
+static QString expandRegexReplacement(const QString &replaceText, const std::function<QString(int)> &capture) {
+    QString text;
+    bool esc = false;
+    for (QChar ch: replaceText) {
+        if (esc) {
+            if (ch >= '1' && ch <= '9') {
+                text += capture(ch.unicode() - '0');
+            } else if (ch == '\\') {
+                text += '\\';
+            }
+            esc = false;
+        } else {
+            if (ch == '\\') {
+                esc = true;
+            } else {
+                text += ch;
+            }
+        }
+    }
+    return text;
+}
+
+struct ReplacedLine {
+    int line = 0;
+    QString text;
+    // End of the last replacement in text.
+    int lastReplacementEnd = 0;
+};
+
+// Replaces all matches within single lines of snap, in chunks of lines on all cores. Returns the lines whose text
+// changed in order, count is set to the number of replaced matches.
+static QVector<ReplacedLine> replaceInLines(const Tui::ZDocumentSnapshot &snap, const QString &searchText,
+                                            const QString &replaceText, Qt::CaseSensitivity caseSensitivity,
+                                            bool regex, int &count) {
+    QRegularExpression rx;
+    if (regex) {
+        rx.setPattern(searchText);
+        if (caseSensitivity == Qt::CaseInsensitive) {
+            rx.setPatternOptions(QRegularExpression::PatternOption::CaseInsensitiveOption);
+        }
+        if (!rx.isValid()) {
+            count = 0;
+            return {};
+        }
+        rx.optimize();
+    }
+
+    struct Chunk {
+        int begin = 0;
+        int end = 0;
+        QVector<ReplacedLine> lines;
+    };
+
+    const int lineCount = snap.lineCount();
+    const int chunkLines = std::max(1000, lineCount / (QThread::idealThreadCount() * 4));
+    QVector<Chunk> chunks;
+    for (int begin = 0; begin < lineCount; begin += chunkLines) {
+        chunks.append(Chunk{begin, std::min(begin + chunkLines, lineCount), {}});
+    }
+
+    std::atomic<int> replaced = 0;
+    QtConcurrent::blockingMap(chunks, [&](Chunk &chunk) {
+        for (int line = chunk.begin; line < chunk.end; line++) {
+            const QString text = snap.line(line);
+            QString result;
+            int matches = 0;
+            int last = 0;
+            if (regex) {
+                QRegularExpressionMatchIterator it = rx.globalMatch(text);
+                while (it.hasNext()) {
+                    const QRegularExpressionMatch match = it.next();
+                    if (match.capturedLength() == 0) {
+                        continue;
+                    }
+                    result += text.midRef(last, match.capturedStart() - last);
+                    result += expandRegexReplacement(replaceText, [&match](int captureNumber) {
+                        return match.captured(captureNumber);
+                    });
+                    last = match.capturedEnd();
+                    matches++;
+                }
+            } else {
+                int found = 0;
+                while ((found = text.indexOf(searchText, found, caseSensitivity)) != -1) {
+                    result += text.midRef(last, found - last);
+                    result += replaceText;
+                    found += searchText.size();
+                    last = found;
+                    matches++;
+                }
+            }
+            if (matches) {
+                const int lastReplacementEnd = result.size();
+                result += text.midRef(last);
+                replaced += matches;
+                if (result != text) {
+                    chunk.lines.append(ReplacedLine{line, result, lastReplacementEnd});
+                }
+            }
+        }
+    });
+
+    QVector<ReplacedLine> lines;
+    for (const Chunk &chunk: chunks) {
+        lines.append(chunk.lines);
+    }
+    count = replaced;
+    return lines;
+}
+
 void File::replaceSelected() {
-    if (!_currentSearchMatch || hasBlockSelection() || hasMultiInsert()) {
+    if (!_currentSearchMatch || hasBlockSelection() || hasMultiInsert() || isReadOnlyView()) {
         return;
     }
 
@@ -1063,28 +2664,14 @@ void File::replaceSelected() {
         QString text;
 
         if (_searchRegex) {
-            bool esc = false;
-            for (QChar ch: _replaceText) {
-                if (esc) {
-                    if (ch >= '1' && ch <= '9') {
-                        const int captureNumber = (ch.unicode() - '0');
-                        if (std::holds_alternative<Tui::ZDocumentFindAsyncResult>(*_currentSearchMatch)) {
-                            text += std::get<Tui::ZDocumentFindAsyncResult>(*_currentSearchMatch).regexCapture(captureNumber);
-                        } else if (std::holds_alternative<Tui::ZDocumentFindResult>(*_currentSearchMatch)) {
-                            text += std::get<Tui::ZDocumentFindResult>(*_currentSearchMatch).regexCapture(captureNumber);
-                        }
-                    } else if (ch == '\\') {
-                        text += '\\';
-                    }
-                    esc = false;
-                } else {
-                    if (ch == '\\') {
-                        esc = true;
-                    } else {
-                        text += ch;
-                    }
+            text = expandRegexReplacement(_replaceText, [this](int captureNumber) {
+                if (std::holds_alternative<Tui::ZDocumentFindAsyncResult>(*_currentSearchMatch)) {
+                    return std::get<Tui::ZDocumentFindAsyncResult>(*_currentSearchMatch).regexCapture(captureNumber);
+                } else if (std::holds_alternative<Tui::ZDocumentFindResult>(*_currentSearchMatch)) {
+                    return std::get<Tui::ZDocumentFindResult>(*_currentSearchMatch).regexCapture(captureNumber);
                 }
-            }
+                return QString();
+            });
         } else {
             text = _replaceText;
         }
@@ -1100,6 +2687,10 @@ void File::replaceSelected() {
 }
 
 void File::runSearch(bool direction) {
+    if (isLoading()) {
+        _pendingAfterLoading.push_back([this, direction] { runSearch(direction); });
+        return;
+    }
     if (_searchText != "") {
         setSearchVisible(true);
         if (_searchNextFuture) {
@@ -1120,6 +2711,44 @@ void File::runSearch(bool direction) {
             flags |= Tui::ZDocument::FindFlag::FindBackward;
         }
 
+        if (searchIndexValid()) {
+            // Jump directly to the next match in the index instead of searching the document.
+            const QVector<SearchMatch> &matches = _searchIndex->matches;
+            const Tui::ZDocumentCursor cursor = textCursor();
+            const Tui::ZDocumentCursor::Position from = effectiveDirection ? cursor.selectionEndPos()
+                                                                           : cursor.selectionStartPos();
+            auto it = std::lower_bound(matches.begin(), matches.end(), from,
+                                       [](const SearchMatch &match, const Tui::ZDocumentCursor::Position &pos) {
+                return positionBefore(match.start, pos);
+            });
+            int i = it - matches.begin();
+            if (!effectiveDirection) {
+                i--;
+            }
+            if (_searchWrap && matches.size()) {
+                i = (i + matches.size()) % matches.size();
+            }
+            if (0 <= i && i < matches.size()) {
+                const SearchMatch &match = matches[i];
+                if (_searchRegex) {
+                    // The captures are needed for replacing, the search from the start of the match finds it right away.
+                    Tui::ZDocumentCursor matchCursor = cursor;
+                    matchCursor.setPosition(match.start);
+                    Tui::ZDocument::FindFlags forwardFlags = flags;
+                    forwardFlags.setFlag(Tui::ZDocument::FindFlag::FindBackward, false);
+                    Tui::ZDocumentFindResult details = document()->findSyncWithDetails(QRegularExpression(_searchText),
+                                                                                       matchCursor, forwardFlags);
+                    const Tui::ZDocumentCursor found = details.cursor();
+                    if (found.hasSelection()) {
+                        selectSearchMatch(found.anchor(), found.position(), effectiveDirection, details);
+                    }
+                } else {
+                    selectSearchMatch(match.start, match.end, effectiveDirection, std::monostate());
+                }
+            }
+            return;
+        }
+
         auto watcher = new QFutureWatcher<Tui::ZDocumentFindAsyncResult>();
 
         QObject::connect(watcher, &QFutureWatcher<Tui::ZDocumentFindAsyncResult>::finished, this,
@@ -1127,28 +2756,9 @@ void File::runSearch(bool direction) {
             if (!watcher->isCanceled()) {
                 Tui::ZDocumentFindAsyncResult res = watcher->future().result();
                 if (res.anchor() != res.cursor()) { // has a match?
-                    clearAdvancedSelection();
-
-                    if (selectMode()) {
-                        if (effectiveDirection) {
-                            setCursorPosition(res.cursor(), true);
-                        } else {
-                            setCursorPosition(res.anchor(), true);
-                        }
-                    } else {
-                        setSelection(res.anchor(), res.cursor());
-                    }
                     //TODO:
                     //res.wrapped();
-
-                    _currentSearchMatch.emplace(res);
-
-                    updateCommands();
-
-                    const auto [currentCodeUnit, currentLine] = cursorPosition();
-
-                    setScrollPosition(scrollPositionColumn(), std::max(0, currentLine - 1), 0);
-                    adjustScrollPosition();
+                    selectSearchMatch(res.anchor(), res.cursor(), effectiveDirection, res);
                 }
             }
             watcher->deleteLater();
@@ -1170,7 +2780,7 @@ int File::replaceAll(QString searchText, QString replaceText) {
     // Get rid of block selections and multi insert.
     clearSelection();
 
-    if (searchText.isEmpty()) {
+    if (searchText.isEmpty() || isReadOnlyView()) {
         return 0;
     }
 
@@ -1178,34 +2788,71 @@ int File::replaceAll(QString searchText, QString replaceText) {
     auto undoGroup = document()->startUndoGroup(&cursor);
     int counter = 0;
 
-    Tui::ZDocument::FindFlags flags;
-    if (_searchCaseSensitivity == Qt::CaseSensitive) {
-        flags |= Tui::ZDocument::FindFlag::FindCaseSensitively;
-    }
-
-    cursor.setPosition({0, 0});
-    while (true) {
-        Tui::ZDocumentCursor found = cursor;
-        auto match = _currentSearchMatch;
-        if (_searchRegex) {
-            Tui::ZDocumentFindResult details = document()->findSyncWithDetails(QRegularExpression(_searchText),
-                                                                               cursor, flags);
-            match = details;
-            found = details.cursor();
-        } else {
-            found = document()->findSync(_searchText, cursor, flags);
-            match = std::monostate();
+    if (!_searchRegex && _searchText.contains('\n')) {
+        // Matches can span several lines, replace them one by one.
+        Tui::ZDocument::FindFlags flags;
+        if (_searchCaseSensitivity == Qt::CaseSensitive) {
+            flags |= Tui::ZDocument::FindFlag::FindCaseSensitively;
         }
-        if (!found.hasSelection()) {  // has no match?
-            break;
+
+        cursor.setPosition({0, 0});
+        while (true) {
+            Tui::ZDocumentCursor found = document()->findSync(_searchText, cursor, flags);
+            if (!found.hasSelection()) {  // has no match?
+                break;
+            }
+
+            setSelection(found.anchor(), found.position());
+            _currentSearchMatch = std::monostate();
+
+            replaceSelected();
+            cursor = textCursor();
+            counter++;
         }
+    } else {
+        // The new text of all lines is computed first, then each run of changed lines is replaced by one edit.
+        const QVector<ReplacedLine> lines = replaceInLines(document()->snapshot(), _searchText, _replaceText,
+                                                           _searchCaseSensitivity, _searchRegex, counter);
+        // Indexing the intermediate states is useless, the search count is restarted below.
+        _searchIndex.reset();
+
+        // Line numbers of the lines after an edit change when the replacement adds or removes line breaks.
+        int shift = 0;
+        for (int i = 0; i < lines.size();) {
+            int end = i + 1;
+            while (end < lines.size() && lines[end].line == lines[end - 1].line + 1) {
+                end++;
+            }
+            const int firstLine = lines[i].line + shift;
+            const int lastLine = lines[end - 1].line + shift;
+            QStringList texts;
+            for (int j = i; j < end; j++) {
+                texts.append(lines[j].text);
+            }
+            const QString text = texts.join('\n');
+
+            cursor.setPosition({0, firstLine});
+            cursor.setPosition({document()->lineCodeUnits(lastLine), lastLine}, true);
+            cursor.insertText(text);
+
+            if (end == lines.size()) {
+                // Like replacing match by match, the cursor ends up behind the last replacement.
+                const int offset = text.size() - lines.last().text.size() + lines.last().lastReplacementEnd;
+                const int lineStart = offset ? text.lastIndexOf('\n', offset - 1) + 1 : 0;
+                cursor.setPosition({offset - lineStart, firstLine + text.leftRef(offset).count('\n')});
+            }
 
-        setSelection(found.anchor(), found.position());
-        _currentSearchMatch = match;
+            shift += text.count('\n') - (end - 1 - i);
+            i = end;
+        }
 
-        replaceSelected();
-        cursor = textCursor();
-        counter++;
+        if (lines.size()) {
+            setTextCursor(cursor);
+#ifdef SYNTAX_HIGHLIGHTING
+            // The highlighting of edits is otherwise only redone starting at the cursor.
+            _syntaxHighlightDirtyLine = std::min(_syntaxHighlightDirtyLine, lines.first().line);
+#endif
+        }
     }
 
     const auto [currentCodeUnit, currentLine] = cursorPosition();
@@ -1215,7 +2862,7 @@ int File::replaceAll(QString searchText, QString replaceText) {
 
     adjustScrollPosition();
     // Update search count
-    setSearchText(searchText);
+    restartSearch();
     return counter;
 }
 
@@ -1362,7 +3009,7 @@ void File::paintEvent(Tui::ZPaintEvent *event) {
     std::optional<Tui::ZPainter> painterLeftOfMargin;
 
     auto scrollPositionColumns = scrollPositionColumn();
-    const int leftBordersWidth = lineNumberBorderWidth() + lineMarkerBorderWidth();
+    const int leftBordersWidth = lineNumberWidth() + lineMarkerBorderWidth();
 
     auto *painter = event->painter();
     if (_rightMarginHint) {
@@ -1417,6 +3064,44 @@ void File::paintEvent(Tui::ZPaintEvent *event) {
     const auto [cursorCodeUnit, cursorLineReal] = cursor.position();
     const int cursorLine = _blockSelect ? _blockSelectEndLine->line() : cursorLineReal;
 
+#ifdef SYNTAX_HIGHLIGHTING
+    // Lines are only highlighted here while the time spent stays within syntaxHighlightingPaintBudget, a long
+    // line is cut off to fit. Whatever does not fit is shown with the stored or without highlighting and is
+    // completed by the background job or in the next frame.
+    bool degraded = false;
+    bool repaint = false;
+    bool highlighterBusy = false;
+    qint64 paintHighlightNs = 0;
+    auto highlightNow = [&](int line, const KSyntaxHighlighting::State &state,
+                            bool &cutOff) -> std::optional<SyntaxRuns> {
+        const double remaining = syntaxHighlightingPaintBudget - paintHighlightNs / 1e6;
+        if (paintHighlightNs && remaining <= 0) {
+            return std::nullopt;
+        }
+        const QString text = document()->line(line);
+        const int fits = static_cast<int>(std::max(1000.0, std::min<double>(HighlightExporter::maxLineLength,
+                                                                             remaining * _syntaxHighlightPaintRate)));
+        cutOff = text.size() > fits && fits < HighlightExporter::maxLineLength;
+        QElapsedTimer timer;
+        timer.start();
+        auto res = _syntaxHighlightExporter.tryHighlightLineWrap(text, state, fits);
+        if (!res) {
+            // A background job highlights with the same definition right now, painting does not wait for it.
+            repaint = true;
+            highlighterBusy = true;
+            return std::nullopt;
+        }
+        SyntaxRuns runs = std::get<1>(*res);
+        const qint64 elapsed = timer.nsecsElapsed();
+        paintHighlightNs += elapsed;
+        const int highlighted = std::min<int>(text.size(), fits);
+        if (highlighted >= 1000 && elapsed > 0) {
+            _syntaxHighlightPaintRate = std::max(100.0, highlighted / (elapsed / 1e6));
+        }
+        return runs;
+    };
+#endif
+
     QString strlinenumber;
     int y = -scrollPositionFineLine();
     int tmpLastLineWidth = 0;
@@ -1444,45 +3129,59 @@ void File::paintEvent(Tui::ZPaintEvent *event) {
         if (syntaxHighlightingActive()) {
             if (document()->lineUserData(line)) {
                 auto extraData = std::static_pointer_cast<const ExtraData>(document()->lineUserData(line));
+                degraded |= extraData->partial;
+                bool cutOff = false;
                 if (line == cursorLine && extraData->lineRevision != document()->lineRevision(line)) {
                     // avoid glitches when using the cursor to edit lines
                     // the state can still be stale, but much more edits can be done without visible glitches
                     // with stale state.
-                    highlights += std::get<1>(_syntaxHighlightExporter.highlightLineWrap(document()->line(line), extraData->stateBegin));
+                    if (auto runs = highlightNow(line, extraData->stateBegin, cutOff)) {
+                        appendSyntaxHighlights(highlights, *runs);
+                        degraded |= cutOff;
+                    } else {
+                        appendSyntaxHighlights(highlights, extraData->formats);
+                        degraded = true;
+                    }
+                } else if (extraData->evicted) {
+                    // The ranges were dropped to stay within the memory budget, rebuild them from the stored state.
+                    auto runs = highlightNow(line, extraData->stateBegin, cutOff);
+                    if (runs && !cutOff) {
+                        auto rebuilt = std::make_shared<ExtraData>();
+                        rebuilt->stateBegin = extraData->stateBegin;
+                        rebuilt->stateEnd = extraData->stateEnd;
+                        rebuilt->lineRevision = extraData->lineRevision;
+                        rebuilt->partial = extraData->partial;
+                        rebuilt->formats = *runs;
+                        _syntaxHighlightMemory += syntaxRunsMemory(*rebuilt);
+                        document()->setLineUserData(line, rebuilt);
+                        syntaxHighlightingStored(line);
+                        appendSyntaxHighlights(highlights, rebuilt->formats);
+                        scheduleSyntaxHighlightingEviction();
+                    } else if (runs) {
+                        // Too long to be highlighted completely within the budget, stays evicted.
+                        appendSyntaxHighlights(highlights, *runs);
+                        degraded = true;
+                    } else {
+                        degraded = true;
+                        repaint = true;
+                    }
                 } else {
-                    highlights += extraData->highlights;
+                    appendSyntaxHighlights(highlights, extraData->formats);
                 }
+            } else if (_syntaxHighlightOverBudget) {
+                // not reached by the running job yet
+                degraded = true;
             }
         }
 #endif
 
         // search matches
         if (searchVisible() && _searchText != "") {
-            int found = -1;
-            if (_searchRegex) {
-                QRegularExpression rx(_searchText);
-                if (rx.isValid()) {
-                    if (_searchCaseSensitivity == Qt::CaseInsensitive) {
-                        rx.setPatternOptions(QRegularExpression::PatternOption::CaseInsensitiveOption);
-                    }
-                    QRegularExpressionMatchIterator i = rx.globalMatch(document()->line(line));
-                    while (i.hasNext()) {
-                        QRegularExpressionMatch match = i.next();
-                        if (match.capturedLength() > 0) {
-                            highlights.append(Tui::ZFormatRange{match.capturedStart(), match.capturedLength(),
-                                                                {Tui::Colors::darkGray, {0xff, 0xdd, 0}, Tui::ZTextAttribute::Bold},
-                                                                selectedFormatingChar,
-                                                                FR_UD_LIVE_SEARCH});
-                        }
-                    }
-                }
-            } else {
-                while ((found = document()->line(line).indexOf(_searchText, found + 1, _searchCaseSensitivity)) != -1) {
-                    highlights.append(Tui::ZFormatRange{found, _searchText.size(),
-                                                        {Tui::Colors::darkGray, {0xff, 0xdd, 0}, Tui::ZTextAttribute::Bold},
-                                                        selectedFormatingChar,
-                                                        FR_UD_LIVE_SEARCH});
-                }
+            for (const auto &match: searchMatchesInLine(line)) {
+                highlights.append(Tui::ZFormatRange{match.first, match.second,
+                                                    {Tui::Colors::darkGray, {0xff, 0xdd, 0}, Tui::ZTextAttribute::Bold},
+                                                    selectedFormatingChar,
+                                                    FR_UD_LIVE_SEARCH});
             }
         }
         if (_bracketPosition.codeUnit >= 0) {
@@ -1613,12 +3312,11 @@ void File::paintEvent(Tui::ZPaintEvent *event) {
                 painter->writeWithColors(0, y + i, QString(" ").repeated(leftBordersWidth),
                                          getColor("chr.linenumberFg"), getColor("chr.linenumberBg"));
             }
+            const QString number = QString::number(_pageFirstLine + line + 1);
             if (hasLineMarker(line)) {
-                strlinenumber = QString::number(line + 1)
-                                + QString("*") + QString(" ").repeated(lineNumberBorderWidth() - QString::number(line + 1).size());
+                strlinenumber = number + QString("*") + QString(" ").repeated(lineNumberWidth() - number.size());
             } else {
-                strlinenumber = QString::number(line + 1)
-                                + QString(" ").repeated(leftBordersWidth - QString::number(line + 1).size());
+                strlinenumber = number + QString(" ").repeated(leftBordersWidth - number.size());
             }
             int lineNumberY = y;
             if (y < 0) {
@@ -1656,7 +3354,26 @@ void File::paintEvent(Tui::ZPaintEvent *event) {
         }
         y += lay.lineCount();
     }
-    if (document()->newlineAfterLastLineMissing()) {
+
+#ifdef SYNTAX_HIGHLIGHTING
+    if (degraded != _syntaxHighlightDegraded) {
+        _syntaxHighlightDegraded = degraded;
+        syntaxHighlightingDegradedChanged(degraded);
+    }
+    if (repaint && !_syntaxHighlightRepaintPending) {
+        // continue with the lines that did not fit into this frame
+        _syntaxHighlightRepaintPending = true;
+        // Retrying right away would mostly find the highlighter still busy.
+        QTimer::singleShot(highlighterBusy ? 5 : 0, this, [this] {
+            _syntaxHighlightRepaintPending = false;
+            update();
+        });
+    }
+#endif
+
+    if (_mappedFile && (!_mappedFile->indexComplete() || _pageFirstLine + document()->lineCount() < _mappedFile->lineCount())) {
+        // paged view: the end of the document is not the end of the file
+    } else if (document()->newlineAfterLastLineMissing()) {
         if (formattingCharacters() && y < rect().height() && scrollPositionColumns == 0) {
             const Tui::ZTextStyle &markStyle = (_rightMarginHint && tmpLastLineWidth > _rightMarginHint) ? formatingCharInMargin : formatingChar;
 
@@ -1680,27 +3397,189 @@ int File::pageNavigationLineCount() const {
     return std::max(1, geometry().height() - 1);
 }
 
-void File::appendLine(const QString &line) {
+void File::setStandardInputLimits(int maxLines, qint64 maxBytes) {
+    _stdinMaxLines = std::max(0, maxLines);
+    _stdinMaxBytes = std::max<qint64>(0, maxBytes);
+}
+
+int File::standardInputMaxLines() const {
+    return _stdinMaxLines;
+}
+
+qint64 File::standardInputMaxBytes() const {
+    return _stdinMaxBytes;
+}
+
+void File::trimStandardInput() {
+    // The limits are only enforced after they are exceeded by an eighth, then the oldest lines are dropped in
+    // one block. This keeps the amortized cost per appended line constant.
+    const int lineCount = document()->lineCount();
+    int dropLines = 0;
+    if (_stdinMaxLines > 0 && lineCount > _stdinMaxLines + _stdinMaxLines / 8) {
+        dropLines = lineCount - _stdinMaxLines;
+    }
+
+    // QString uses 2 bytes per code unit
+    const qint64 maxCodeUnits = _stdinMaxBytes / 2;
+    if (maxCodeUnits > 0 && _stdinCodeUnits > maxCodeUnits + maxCodeUnits / 8) {
+        qint64 dropCodeUnits = 0;
+        for (int line = 0; line < dropLines; line++) {
+            dropCodeUnits += document()->lineCodeUnits(line) + 1;
+        }
+        while (_stdinCodeUnits - dropCodeUnits > maxCodeUnits && dropLines < lineCount - 1) {
+            dropCodeUnits += document()->lineCodeUnits(dropLines) + 1;
+            dropLines++;
+        }
+    }
+
+    dropLines = std::min(dropLines, lineCount - 1);
+    if (dropLines <= 0) {
+        return;
+    }
+
+    // The lines are removed with an edit, so the undo history and the highlighting of the kept lines stay. The
+    // cursor, selection and line markers are moved along by the document.
+    clearAdvancedSelection();
+    const int scrollColumn = scrollPositionColumn();
+    const int scrollLine = scrollPositionLine();
+    const int scrollFineLine = scrollPositionFineLine();
+    for (int line: _lineMarker->listMarker()) {
+        if (line < dropLines) {
+            _lineMarker->removeMarker(line);
+        }
+    }
+
+    for (int line = 0; line < dropLines; line++) {
+        _stdinCodeUnits -= document()->lineCodeUnits(line) + 1;
+    }
+
+#ifdef SYNTAX_HIGHLIGHTING
+    for (int line = 0; line < dropLines; line++) {
+        if (auto data = std::static_pointer_cast<const ExtraData>(document()->lineUserData(line))) {
+            _syntaxHighlightMemory -= syntaxRunsMemory(*data);
+        }
+    }
+    _syntaxHighlightMemory = std::max<qint64>(0, _syntaxHighlightMemory);
+    if (_syntaxHighlightDirtyLine != std::numeric_limits<int>::max()) {
+        _syntaxHighlightDirtyLine = std::max(0, _syntaxHighlightDirtyLine - dropLines);
+    }
+    // The first kept line is joined with the removed text by the edit, its highlight is carried over.
+    auto firstKept = std::static_pointer_cast<const ExtraData>(document()->lineUserData(dropLines));
+    const bool keepAppend = _syntaxHighlightAppendLine >= 0
+            && _syntaxHighlightAppendRevision == document()->revision();
+#endif
+
+    {
+        auto undoGroup = startUndoGroup();
+        Tui::ZDocumentCursor cur = makeCursor();
+        cur.setPosition({0, 0});
+        cur.setPosition({0, dropLines}, true);
+        cur.removeSelectedText();
+    }
+
+#ifdef SYNTAX_HIGHLIGHTING
+    if (firstKept) {
+        auto moved = std::make_shared<ExtraData>();
+        moved->stateBegin = firstKept->stateBegin;
+        moved->stateEnd = firstKept->stateEnd;
+        moved->formats = firstKept->formats;
+        moved->lineRevision = document()->lineRevision(0);
+        moved->evicted = firstKept->evicted;
+        moved->cached = firstKept->cached;
+        moved->partial = firstKept->partial;
+        document()->setLineUserData(0, moved);
+    }
+    if (keepAppend) {
+        // Still only appended to, the removal at the start does not need a sweep.
+        _syntaxHighlightAppendLine = std::max(0, _syntaxHighlightAppendLine - dropLines);
+        _syntaxHighlightAppendRevision = document()->revision();
+    }
+#endif
+
+    setScrollPosition(scrollColumn, std::max(0, scrollLine - dropLines), scrollFineLine);
+    modifiedChanged(true);
+}
+
+void File::appendLines(const QStringList &lines) {
+    if (lines.isEmpty()) {
+        return;
+    }
+
+    // All lines are inserted in one step, so the document only has to be updated once per batch.
+    const int appendLine = document()->lineCount() - 1;
+    const unsigned revisionBefore = document()->revision();
     Tui::ZDocumentCursor cur = makeCursor();
     if (document()->lineCount() == 1 && document()->lineCodeUnits(0) == 0) {
-        cur.insertText(line);
+        cur.insertText(lines.join('\n'));
         // We reposition the cursor so that the cursor is not moved in front of the cur coursor.
         Tui::ZDocumentCursor cursor = textCursor();
         cursor.setPosition({0, 0});
         setTextCursor(cursor);
     } else {
         cur.moveToEndOfDocument();
-        cur.insertText("\n" + line);
+        cur.insertText("\n" + lines.join('\n'));
     }
-    if (_followMode) {
-        Tui::ZDocumentCursor cursor = textCursor();
-        cursor.setPosition({cursor.position().codeUnit, document()->lineCount() - 1});
-        setTextCursor(cursor);
+    syntaxHighlightingAppended(appendLine, revisionBefore);
+
+    if (_stdin) {
+        for (const QString &line: lines) {
+            _stdinCodeUnits += line.size() + 1;
+        }
+        trimStandardInput();
+    }
+
+    scheduleAppendUpdate();
+}
+
+void File::appendFileText(const QString &text, qint64 bytes) {
+    const bool wasModified = isModified();
+    if (_loadedFileSize >= 0) {
+        _loadedFileSize += bytes;
+    }
+
+    const int appendLine = document()->lineCount() - 1;
+    const unsigned revisionBefore = document()->revision();
+    Tui::ZDocumentCursor cur = makeCursor();
+    cur.moveToEndOfDocument();
+    if (document()->newlineAfterLastLineMissing()) {
+        // continues the last line
+        cur.insertText(text);
+        document()->setNewlineAfterLastLineMissing(false);
+    } else {
+        cur.insertText("\n" + text);
+    }
+    syntaxHighlightingAppended(appendLine, revisionBefore);
+
+    if (!wasModified) {
+        // The document still matches the file on disk.
+        document()->markUndoStateAsSaved();
+    }
+
+    scheduleAppendUpdate();
+}
+
+void File::scheduleAppendUpdate() {
+    // Scrolling and following the end is only done once per event loop iteration, even if several batches
+    // arrive in between.
+    if (!_appendUpdatePending) {
+        _appendUpdatePending = true;
+        QTimer::singleShot(0, this, [this] {
+            _appendUpdatePending = false;
+            if (_followMode) {
+                Tui::ZDocumentCursor cursor = textCursor();
+                cursor.setPosition({cursor.position().codeUnit, document()->lineCount() - 1});
+                setTextCursor(cursor);
+            }
+            adjustScrollPosition();
+        });
     }
-    adjustScrollPosition();
 }
 
 void File::insertText(const QString &str) { // TODO das ist kein insertText... Oder vielleicht doch?
+    if (isReadOnlyView()) {
+        return;
+    }
+
     auto undoGroup = startUndoGroup();
 
     if (_blockSelect) {
@@ -1771,6 +3650,9 @@ void File::insertText(const QString &str) { // TODO das ist kein insertText... O
 }
 
 void File::sortSelecedLines() {
+    if (isReadOnlyView()) {
+        return;
+    }
     if (hasBlockSelection() || hasMultiInsert() || ZTextEdit::hasSelection()) {
         const auto [startLine, endLine] = getSelectedLines();
         auto lines = getSelectedLinesSort();
@@ -1808,6 +3690,10 @@ bool File::followStandardInput() {
 }
 
 void File::pasteEvent(Tui::ZPasteEvent *event) {
+    if (isReadOnlyView()) {
+        return;
+    }
+
     QString text = event->text();
     if (_formattingCharacters) {
         text.replace(QString("·"), QString(" "));
@@ -1824,6 +3710,13 @@ void File::pasteEvent(Tui::ZPasteEvent *event) {
 
 void File::focusInEvent(Tui::ZFocusEvent *event) {
     Q_UNUSED(event);
+#ifdef SYNTAX_HIGHLIGHTING
+    auto &files = syntaxHighlightingFiles();
+    auto it = std::find(files.begin(), files.end(), this);
+    if (it != files.end()) {
+        std::rotate(files.begin(), it, it + 1);
+    }
+#endif
     updateCommands();
     if (_searchText == "") {
         _cmdSearchNext->setEnabled(false);
@@ -1868,6 +3761,30 @@ int File::visualLineCount() {
 }
 
 void File::keyEvent(Tui::ZKeyEvent *event) {
+    if (isLoading()) {
+        if (event->key() == Qt::Key_Escape && event->modifiers() == 0) {
+            cancelLoading();
+        }
+        return;
+    }
+    if (_mappedFile) {
+        // paged view is read only
+        _pagedRestorePosition.reset();
+        if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_Home) {
+            pagedShowLine({0, 0}, {0, 0}, 0);
+            adjustScrollPosition();
+            return;
+        } else if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_End) {
+            const int lastLine = std::max(0, _mappedFile->lineCount() - 1);
+            const Tui::ZDocumentCursor::Position end = {static_cast<int>(_mappedFile->line(lastLine).size()), lastLine};
+            pagedShowLine(end, end, lastLine);
+            adjustScrollPosition();
+            return;
+        } else if (!pagedIsViewKey(event)) {
+            return;
+        }
+    }
+
     auto undoGroup = startUndoGroup();
 
     QString text = event->text();
@@ -2437,6 +4354,8 @@ void File::adjustScrollPosition() {
         return;
     }
 
+    pagedCheckWindow();
+
     int newScrollPositionLine = scrollPositionLine();
     int newScrollPositionColumn = scrollPositionColumn();
     int newScrollPositionFineLine = scrollPositionFineLine();
@@ -3,18 +3,24 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <array>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <variant>
 
+#include <QHash>
 #include <QJsonObject>
 #include <QPair>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTimer>
 
 #ifdef SYNTAX_HIGHLIGHTING
 #include <KSyntaxHighlighting/AbstractHighlighter>
 #include <KSyntaxHighlighting/Definition>
-#include <KSyntaxHighlighting/Repository>
 #include <KSyntaxHighlighting/State>
 #include <KSyntaxHighlighting/Theme>
 #endif
@@ -29,20 +35,46 @@
 #include <Tui/ZTextOption.h>
 #include <Tui/ZWidget.h>
 
+#include "attributes.h"
+#include "fileloader.h"
+#include "mappedfile.h"
 #include "markermanager.h"
+#include "searchcount.h"
+#include "syntaxrepository.h"
+#include "syntaxruns.h"
 
 struct ExtraData : public Tui::ZDocumentLineUserData {
 #ifdef SYNTAX_HIGHLIGHTING
     KSyntaxHighlighting::State stateBegin;
     KSyntaxHighlighting::State stateEnd;
 #endif
-    QVector<Tui::ZFormatRange> highlights;
+    SyntaxRuns formats;
     unsigned lineRevision = -1;
+    // The formats were dropped to stay within the memory budget, the states are still valid.
+    bool evicted = false;
+    // The formats were read from the highlight cache, the states are not known until the line is highlighted.
+    bool cached = false;
+    // The line is longer than HighlightExporter::maxLineLength, only its start is highlighted.
+    bool partial = false;
 };
 struct Updates {
     QList<std::shared_ptr<ExtraData>> data;
     QList<int> lines;
+    // Text of the highlighted lines, to find them again when lines were inserted or removed in the meantime.
+    QStringList texts;
     unsigned documentRevision = 0;
+    int documentLineCount = 0;
+    // Set on the last update of a job that ran to completion.
+    bool complete = false;
+    unsigned generation = 0;
+};
+
+struct SyntaxHighlightingCounters {
+    // Calls to updateSyntaxHighlighting, several of them are merged into one job.
+    int requested = 0;
+    int queued = 0;
+    int abandoned = 0;
+    int completed = 0;
 };
 
 Q_DECLARE_METATYPE(Updates);
@@ -51,26 +83,91 @@ class SyntaxHighlightingSignalForwarder : public QObject {
     Q_OBJECT
 signals:
     void updates(Updates);
+    void finished(bool completed);
 };
 
 #ifdef SYNTAX_HIGHLIGHTING
 
+// Formats seen while highlighting, by their id. Shared by all highlighters of a document.
+class SyntaxFormatTable {
+public:
+    void add(const KSyntaxHighlighting::Format &format);
+    std::optional<KSyntaxHighlighting::Format> format(quint16 id) const;
+
+private:
+    mutable std::mutex _mutex;
+    QHash<quint16, KSyntaxHighlighting::Format> _formats;
+};
+
 class HighlightExporter : public KSyntaxHighlighting::AbstractHighlighter {
 public:
-    std::tuple<KSyntaxHighlighting::State, QVector<Tui::ZFormatRange>> highlightLineWrap(const QString &text, const KSyntaxHighlighting::State &state);
+    // Longer lines (e.g. minified files) are only highlighted up to this length, the time a single line takes
+    // is otherwise unbounded.
+    static constexpr int maxLineLength = 100000;
 
-    Tui::ZColor defBg;
-    Tui::ZColor defFg;
+public:
+    // Highlights at most the first maxLength code units of text.
+    std::tuple<KSyntaxHighlighting::State, SyntaxRuns> highlightLineWrap(const QString &text, const KSyntaxHighlighting::State &state,
+                                                                         int maxLength = maxLineLength);
+    void setFormatTable(std::shared_ptr<SyntaxFormatTable> formatTable);
+    // Like highlightLineWrap, but gives up instead of waiting for another thread highlighting with the definition.
+    std::optional<std::tuple<KSyntaxHighlighting::State, SyntaxRuns>> tryHighlightLineWrap(const QString &text,
+                                                                                           const KSyntaxHighlighting::State &state,
+                                                                                           int maxLength = maxLineLength);
+    // Highlighting with a definition that other threads use too has to hold its lock.
+    void setDefinitionLock(std::shared_ptr<const SyntaxDefinitionLock> definitionLock);
+
+    // Configuration of the HighlighterPool this instance was last set up with.
+    unsigned configRevision = -1;
 
 protected:
     void applyFormat(int offset, int length, const KSyntaxHighlighting::Format &format) override;
 
 protected:
-    // The whole object graph of the syntax highlighter is not safe to share across threads...
-    // so we need to use a fine grained lock to avoid blocking the UI thread for too long.
-    std::mutex mutex;
+    SyntaxRuns highlights;
+    std::shared_ptr<SyntaxFormatTable> formatTable;
+    // Formats already added to formatTable, avoids taking its lock for every range.
+    QSet<quint16> knownFormats;
+    std::shared_ptr<const SyntaxDefinitionLock> definitionLock;
+
+private:
+    std::tuple<KSyntaxHighlighting::State, SyntaxRuns> highlightUnlocked(const QString &text,
+                                                                         const KSyntaxHighlighting::State &state,
+                                                                         int maxLength);
+};
+
+// Lines that end in equal states share one copy of the state data instead of each keeping its own. Most lines
+// end in one of a few states.
+class SyntaxStateCache {
+public:
+    KSyntaxHighlighting::State deduplicate(const KSyntaxHighlighting::State &state);
+
+private:
+    std::array<KSyntaxHighlighting::State, 8> _recent;
+    size_t _next = 0;
+};
+
+// The highlighter keeps state while highlighting a line and is not safe to share across threads. Background
+// jobs lease an instance of their own from this pool, so they never block the instance used for painting.
+class HighlighterPool {
+public:
+    using Lease = std::unique_ptr<HighlightExporter, std::function<void(HighlightExporter*)>>;
 
-    QVector<Tui::ZFormatRange> highlights;
+public:
+    explicit HighlighterPool(std::shared_ptr<SyntaxFormatTable> formatTable);
+
+public:
+    void configure(const KSyntaxHighlighting::Definition &definition,
+                   std::shared_ptr<const SyntaxDefinitionLock> definitionLock);
+    Lease acquire();
+
+private:
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<HighlightExporter>> _idle;
+    std::shared_ptr<SyntaxFormatTable> _formatTable;
+    KSyntaxHighlighting::Definition _definition;
+    std::shared_ptr<const SyntaxDefinitionLock> _definitionLock;
+    unsigned _configRevision = 0;
 };
 
 #endif
@@ -85,6 +182,18 @@ public:
     QString getFilename();
     bool saveText();
     bool openText(QString filename);
+    // Reads the file in a background thread, the result is reported by loadingFinished.
+    bool openTextAsync(QString filename, std::optional<Tui::ZDocumentCursor::Position> cursorPosition = std::nullopt);
+    void cancelLoading();
+    bool isLoading() const;
+    bool openPaged(QString filename);
+    bool isPaged() const;
+    // Size and inode of the file as the document was read from or saved to it, the size is -1 when the
+    // document does not correspond to a complete file.
+    qint64 loadedFileSize() const;
+    quint64 loadedFileInode() const;
+    void setPagedViewThreshold(qint64 bytes);
+    qint64 pagedViewThreshold() const;
     void cutline();
     void deleteLine();
     void copy() override;
@@ -106,7 +215,16 @@ public:
     bool hasBlockSelection() const;
     bool hasMultiInsert() const;
     bool removeSelectedText();
-    void appendLine(const QString &line);
+    void appendLines(const QStringList &lines);
+    // Appends text that was added to the backing file. text contains complete lines without the final line break,
+    // bytes is the number of bytes of the file it was decoded from including that line break.
+    void appendFileText(const QString &text, qint64 bytes = 0);
+    void setFollowFile(bool follow);
+    bool followFile() const;
+    // Limits for text read from standard input, older lines are dropped. 0 means unlimited.
+    void setStandardInputLimits(int maxLines, qint64 maxBytes);
+    int standardInputMaxLines() const;
+    qint64 standardInputMaxBytes() const;
     void insertText(const QString &str);
     void setSearchText(QString searchText);
     void setSearchCaseSensitivity(Qt::CaseSensitivity searchCaseSensitivity);
@@ -131,6 +249,15 @@ public:
     QString syntaxHighlightingLanguage();
     void setSyntaxHighlightingActive(bool active);
     bool syntaxHighlightingActive();
+    SyntaxHighlightingCounters syntaxHighlightingCounters() const;
+    // Memory used by the highlighted ranges of this document, in bytes.
+    qint64 syntaxHighlightingMemoryUsage() const;
+    // Budget for the highlighted ranges of all documents, 0 for no limit.
+    static void setSyntaxHighlightingMemoryBudget(qint64 bytes);
+    static qint64 syntaxHighlightingMemoryBudget();
+    // Size of the on-disk highlight cache next to the attributes file, 0 disables it.
+    static void setSyntaxHighlightingCacheSize(qint64 bytes);
+    static qint64 syntaxHighlightingCacheSize();
 
 public:
     void setSearchWrap(bool wrap);
@@ -156,12 +283,23 @@ public slots:
 signals:
     void followStandardInputChanged(bool follow);
     void writableChanged(bool rw);
-    void searchCountChanged(int sc);
+    // complete is false while the count is still running
+    void searchCountChanged(int sc, bool complete);
+    // Number of the selected match starting at 1, 0 when no match is selected or the number is not known yet.
+    void searchMatchChanged(int number);
+    // Positions of the lines with matches relative to the length of the document, for the scroll bar.
+    void searchMarksChanged(QVector<double> marks);
     void searchTextChanged(QString searchText);
     void searchVisibleChanged(bool visible);
     void selectCharLines(int selectChar, int selectLines);
     void syntaxHighlightingLanguageChanged(QString language);
     void syntaxHighlightingEnabledChanged(bool enable);
+    // Some visible lines are shown with partial or without highlighting to keep the editor responsive.
+    void syntaxHighlightingDegradedChanged(bool degraded);
+    // bytesRead is -1 when no loading is in progress
+    void loadingProgressChanged(qint64 bytesRead, qint64 bytesTotal, int lines);
+    void loadingFinished(bool ok);
+    void loadingCanceled();
 
 protected:
     void paintEvent(Tui::ZPaintEvent *event) override;
@@ -176,13 +314,40 @@ protected:
 
 private:
     bool initText();
+    void trimStandardInput();
+    void scheduleAppendUpdate();
+    bool openTextReadFrom();
+    void applyLoadedText(LoadedText &result, std::optional<Tui::ZDocumentCursor::Position> cursorPosition);
+    void openTextFinished(Attributes &a);
+    bool isReadOnlyView() const;
     void adjustScrollPosition() override;
     void emitCursorPostionChanged() override;
+    // Start and length of the live search matches in line, cached until the line or the search changes.
+    const QVector<QPair<int, int>> &searchMatchesInLine(int line);
+    // Starts counting and indexing over for a changed search.
+    void restartSearch();
+    // Counts and indexes the matches of the current search, only the changed lines when previous is given.
+    void startSearchCount(std::shared_ptr<const SearchIndex> previous);
+    void ingestSearchIndex(std::shared_ptr<const SearchIndex> index);
+    void updateSearchIndex();
+    bool searchIndexValid() const;
+    void selectSearchMatch(Tui::ZDocumentCursor::Position anchor, Tui::ZDocumentCursor::Position cursor, bool forward,
+                           std::variant<std::monostate, Tui::ZDocumentFindAsyncResult, Tui::ZDocumentFindResult> match);
+    void updateSearchMatchNumber();
+    void updateSearchMarks();
 
 
     bool hasLineMarker() const;
     bool hasLineMarker(int line) const;
     int lineMarkerBorderWidth() const;
+    int lineNumberWidth() const;
+
+    // paged view of big files
+    int pagedWindowLineCount() const;
+    void pagedShowLine(Tui::ZDocumentCursor::Position absoluteAnchor, Tui::ZDocumentCursor::Position absoluteCursor,
+                       int absoluteScrollLine);
+    void pagedCheckWindow();
+    bool pagedIsViewKey(Tui::ZKeyEvent *event) const;
 
     Tui::ZTextOption textOption() const override;
 
@@ -216,8 +381,22 @@ private:
 #ifdef SYNTAX_HIGHLIGHTING
     void ingestSyntaxHighlightingUpdates(Updates);
     void updateSyntaxHighlighting(bool force);
+    void startSyntaxHighlightingJob();
+    void syntaxHighlightingJobFinished(bool completed);
     void syntaxHighlightDefinition();
+    void detectSyntaxDefinition();
+    void configureSyntaxHighlighters();
+    Tui::ZTextStyle syntaxHighlightingStyle(quint16 formatId);
+    void appendSyntaxHighlights(QVector<Tui::ZFormatRange> &highlights, const SyntaxRuns &formats);
+    void scheduleSyntaxHighlightingEviction();
+    static void enforceSyntaxHighlightingBudget();
+    void evictSyntaxHighlighting(qint64 bytesToFree);
+    void syntaxHighlightingStored(int line);
+    void loadSyntaxHighlightingCache();
+    void writeSyntaxHighlightingCache();
 #endif
+    // Called after lines were appended starting at line, revisionBefore is the revision of the document before.
+    void syntaxHighlightingAppended(int line, unsigned revisionBefore);
 
 private:
     // block selection
@@ -238,8 +417,25 @@ private:
     bool _searchVisible = false;
     std::shared_ptr<std::atomic<int>> searchGeneration = std::make_shared<std::atomic<int>>();
     std::optional<QFuture<Tui::ZDocumentFindAsyncResult>> _searchNextFuture;
+    // Search state of searchMatchesInLine, rebuilt when searchGeneration changes.
+    struct SearchMatchCacheEntry {
+        unsigned lineRevision = 0;
+        QVector<QPair<int, int>> matches;
+    };
+    int _searchMatchGeneration = -1;
+    QRegularExpression _searchMatchRegex;
+    QHash<int, SearchMatchCacheEntry> _searchMatchCache;
+    // Matches of the current search, only used for navigation while it is of the current document revision.
+    std::shared_ptr<const SearchIndex> _searchIndex;
+    // Running SearchCount jobs, changes of the document are indexed by one job at a time.
+    int _searchIndexJobs = 0;
+    bool _searchIndexUpdatePending = false;
     bool _followMode = false;
     bool _stdin = false;
+    bool _followFile = false;
+    int _stdinMaxLines = 0;
+    qint64 _stdinMaxBytes = 0;
+    qint64 _stdinCodeUnits = 0;
     Position _bracketPosition;
     bool _bracket = false;
     QString _attributesFile;
@@ -249,6 +445,21 @@ private:
     bool _colorTabs = true;
     bool _colorTrailingSpaces = true;
     std::unique_ptr<MarkerManager> _lineMarker;
+    qint64 _pagedViewThreshold = 0;
+    std::unique_ptr<MappedFile> _mappedFile;
+    // Incremented for each mapped file, index progress that was queued for an earlier one is dropped.
+    unsigned _mappedFileGeneration = 0;
+    qint64 _loadedFileSize = -1;
+    quint64 _loadedFileInode = 0;
+    int _pageFirstLine = 0;
+    std::optional<Tui::ZDocumentCursor::Position> _pagedRestorePosition;
+    int _pagedRestoreScrollLine = 0;
+    bool _pagedReloading = false;
+    bool _pagedCheckPending = false;
+    bool _appendUpdatePending = false;
+    std::shared_ptr<std::atomic<bool>> _loadingCancel;
+    // gotoLine and runSearch requested while loading
+    std::vector<std::function<void()>> _pendingAfterLoading;
 
     Tui::ZCommandNotifier *_cmdSearchNext = nullptr;
     Tui::ZCommandNotifier *_cmdSearchPrevious = nullptr;
@@ -258,11 +469,47 @@ private:
     QString _syntaxHighlightingLanguage = "None";
     bool _syntaxHighlightingActive = false;
 #ifdef SYNTAX_HIGHLIGHTING
-    KSyntaxHighlighting::Repository _syntaxHighlightRepo;
     KSyntaxHighlighting::Theme _syntaxHighlightingTheme;
     KSyntaxHighlighting::Definition _syntaxHighlightDefinition;
+    std::shared_ptr<SyntaxFormatTable> _syntaxFormatTable = std::make_shared<SyntaxFormatTable>();
+    // Only used from the UI thread
     HighlightExporter _syntaxHighlightExporter;
+    std::shared_ptr<HighlighterPool> _syntaxHighlighterPool = std::make_shared<HighlighterPool>(_syntaxFormatTable);
+    // Styles for the current theme and colors, by format id.
+    QHash<quint16, Tui::ZTextStyle> _syntaxHighlightStyles;
+    // Lowest line that might need highlighting, edits at the cursor are handled from here.
+    int _syntaxHighlightDirtyLine = 0;
+    // While the document only got lines appended since it was highlighted completely, the first line that
+    // needs highlighting and the revision after the last append. -1 otherwise.
+    int _syntaxHighlightAppendLine = -1;
+    unsigned _syntaxHighlightAppendRevision = 0;
+    bool _syntaxHighlightSweepPending = true;
+    QTimer *_syntaxHighlightSweepTimer = nullptr;
+    // Only one highlighting job runs at a time, requests while it runs are merged into the next job.
+    bool _syntaxHighlightJobScheduled = false;
+    bool _syntaxHighlightJobRunning = false;
+    bool _syntaxHighlightRestartPending = false;
+    // Incremented when the results of the running job become useless without a change of the document.
+    std::shared_ptr<std::atomic<unsigned>> _syntaxHighlightGeneration = std::make_shared<std::atomic<unsigned>>(0);
+    // The highlight cache already has the highlighting of the current file content.
+    bool _syntaxHighlightCacheWritten = false;
+    // Incremented when the file or the chosen language changes, results of older detections are dropped.
+    unsigned _syntaxDetection = 0;
+    // Highlighting jobs that run longer than this leave the lines they did not reach yet without highlighting,
+    // which is shown in the status bar until they are done.
+    QTimer *_syntaxHighlightBudgetTimer = nullptr;
+    bool _syntaxHighlightOverBudget = false;
+    // Measured speed of highlighting in the paint event in code units per millisecond.
+    double _syntaxHighlightPaintRate = 10000;
+    bool _syntaxHighlightRepaintPending = false;
+    bool _syntaxHighlightDegraded = false;
+    // Eviction has already gone through the lines before _syntaxEvictLow and after _syntaxEvictHigh, ranges
+    // stored there later move the markers outwards again. Unset while no line has ranges that can be evicted.
+    std::optional<Tui::ZDocumentLineMarker> _syntaxEvictLow;
+    std::optional<Tui::ZDocumentLineMarker> _syntaxEvictHigh;
 #endif
+    SyntaxHighlightingCounters _syntaxHighlightingCounters;
+    qint64 _syntaxHighlightMemory = 0;
 };
 
 #endif // FILE_H
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "fileloader.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+
+#include "textdecoder.h"
+
+namespace {
+    struct DecodedSegment {
+        QString text;
+        int newlines = 0;
+        bool allLinesCrLf = true;
+    };
+}
+
+static DecodedSegment decodeSegment(const QByteArray &segment) {
+    DecodedSegment result;
+
+    const char *data = segment.constData();
+    const char *end = data + segment.size();
+    const char *lineStart = data;
+    while (const char *newline = findNewline(lineStart, end)) {
+        if (newline == lineStart || newline[-1] != '\r') {
+            result.allLinesCrLf = false;
+        }
+        result.newlines++;
+        lineStart = newline + 1;
+    }
+
+    result.text = decodeText(data, segment.size());
+    return result;
+}
+
+LoadedText loadText(const QString &filename, const std::atomic<bool> &cancel, const FileLoaderProgress &progress) {
+    LoadedText result;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return result;
+    }
+
+    struct stat st;
+    if (::fstat(file.handle(), &st) == 0) {
+        result.inode = st.st_ino;
+    }
+
+    const qint64 bytesTotal = file.size();
+    // A QString can not hold more than this.
+    const qint64 maxCodeUnits = std::numeric_limits<int>::max() / 2 - 16;
+    // Each batch is split into this many segments at line boundaries, which are scanned and decoded in parallel.
+    const int segmentCount = std::max(1, QThread::idealThreadCount());
+    const qint64 segmentSize = 4 * 1024 * 1024;
+
+    if (bytesTotal > maxCodeUnits) {
+        result.tooLarge = true;
+        return result;
+    }
+
+    result.text.reserve(bytesTotal);
+
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
+    QByteArray buffer;
+    qint64 bytesRead = 0;
+    int newlines = 0;
+    bool allLinesCrLf = true;
+    bool lastByteIsNewline = false;
+
+    auto append = [&](const DecodedSegment &segment) {
+        if (result.text.size() + qint64(segment.text.size()) > maxCodeUnits) {
+            return false;
+        }
+        result.text += segment.text;
+        newlines += segment.newlines;
+        allLinesCrLf &= segment.allLinesCrLf;
+        return true;
+    };
+
+    while (true) {
+        if (cancel) {
+            return LoadedText();
+        }
+
+        QByteArray chunk = file.read(segmentSize * segmentCount);
+        if (chunk.isEmpty()) {
+            if (!file.atEnd()) {
+                // read error
+                return LoadedText();
+            }
+            break;
+        }
+        bytesRead += chunk.size();
+        lastByteIsNewline = chunk.endsWith('\n');
+
+        // Only complete lines are decoded, the rest is kept for the next round. This keeps multi byte
+        // sequences together.
+        if (buffer.isEmpty()) {
+            buffer = std::move(chunk);
+        } else {
+            buffer.append(chunk);
+        }
+        const char *data = buffer.constData();
+        const char *lastNewline = static_cast<const char*>(memrchr(data, '\n', buffer.size()));
+        if (!lastNewline) {
+            continue;
+        }
+        const qint64 completeBytes = lastNewline - data + 1;
+
+        QVector<QByteArray> segments;
+        qint64 segmentStart = 0;
+        for (int i = 1; i < segmentCount && segmentStart < completeBytes; i++) {
+            const qint64 nominal = std::max(segmentStart, completeBytes * i / segmentCount);
+            const char *newline = findNewline(data + nominal, data + completeBytes);
+            const qint64 segmentEnd = newline - data + 1;
+            segments.append(QByteArray::fromRawData(data + segmentStart, segmentEnd - segmentStart));
+            segmentStart = segmentEnd;
+        }
+        if (segmentStart < completeBytes) {
+            segments.append(QByteArray::fromRawData(data + segmentStart, completeBytes - segmentStart));
+        }
+
+        if (segments.size() == 1) {
+            if (!append(decodeSegment(segments.first()))) {
+                return LoadedText();
+            }
+        } else {
+            const QVector<DecodedSegment> decoded = QtConcurrent::blockingMapped<QVector<DecodedSegment>>(segments, decodeSegment);
+            for (const DecodedSegment &segment: decoded) {
+                if (!append(segment)) {
+                    return LoadedText();
+                }
+            }
+        }
+
+        segments.clear();
+        buffer.remove(0, completeBytes);
+
+        if (progress && progressTimer.elapsed() >= 50) {
+            progress(bytesRead, bytesTotal, newlines);
+            progressTimer.restart();
+        }
+    }
+
+    if (buffer.size()) {
+        // last line without line break
+        if (!append(decodeSegment(buffer))) {
+            return LoadedText();
+        }
+    }
+
+    result.newlineAfterLastLineMissing = !lastByteIsNewline;
+    if (lastByteIsNewline) {
+        result.text.chop(1);
+    }
+
+    if (newlines > 0 && allLinesCrLf) {
+        result.crLfMode = true;
+        result.text.replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+        if (lastByteIsNewline) {
+            // the line break of the last line was already removed, only '\r' is left
+            result.text.chop(1);
+        }
+    }
+
+    result.lineCount = newlines + (lastByteIsNewline ? 0 : 1);
+    result.bytesRead = bytesRead;
+    result.ok = true;
+
+    if (progress) {
+        progress(bytesRead, bytesTotal, result.lineCount);
+    }
+
+    return result;
+}
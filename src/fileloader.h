@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <atomic>
+#include <functional>
+
+#include <QObject>
+#include <QString>
+
+struct LoadedText {
+    bool ok = false;
+    // The file does not fit into a single QString, it has to be read with ZDocument::readFrom.
+    bool tooLarge = false;
+    // Lines separated by '\n', without a line break after the last line.
+    QString text;
+    int lineCount = 0;
+    bool crLfMode = false;
+    bool newlineAfterLastLineMissing = false;
+    // Number of bytes the text was decoded from and the inode of the file they were read from.
+    qint64 bytesRead = 0;
+    quint64 inode = 0;
+};
+
+Q_DECLARE_METATYPE(LoadedText);
+
+class FileLoaderSignalForwarder : public QObject {
+    Q_OBJECT
+signals:
+    void progress(qint64 bytesRead, qint64 bytesTotal, int lines);
+    void finished(LoadedText result);
+};
+
+using FileLoaderProgress = std::function<void(qint64 bytesRead, qint64 bytesTotal, int lines)>;
+
+// Reads and decodes a file in the same way as ZDocument::readFrom, but is safe to run outside of the main thread.
+// Returns a result with ok == false when reading failed or cancel was set.
+LoadedText loadText(const QString &filename, const std::atomic<bool> &cancel, const FileLoaderProgress &progress);
+
+#endif // FILELOADER_H
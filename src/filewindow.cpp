@@ -2,14 +2,20 @@
 
 #include "filewindow.h"
 
+#include <sys/stat.h>
 #include <unistd.h>
 
-#include <Tui/Misc/SurrogateEscape.h>
+#include <utility>
+
+#include <QElapsedTimer>
+#include <QTimer>
+
 #include <Tui/ZSymbol.h>
 #include <Tui/ZTerminal.h>
 
 #include "alert.h"
 #include "confirmsave.h"
+#include "textdecoder.h"
 
 
 FileWindow::FileWindow(Tui::ZWidget *parent) : Tui::ZWindow(parent) {
@@ -24,6 +30,7 @@ FileWindow::FileWindow(Tui::ZWidget *parent) : Tui::ZWindow(parent) {
     _scrollbarVertical->setTransparent(true);
     QObject::connect(_file, &File::scrollPositionChanged, _scrollbarVertical, &ScrollBar::scrollPosition);
     QObject::connect(_file, &File::scrollRangeChanged, _scrollbarVertical, &ScrollBar::positonMax);
+    QObject::connect(_file, &File::searchMarksChanged, _scrollbarVertical, &ScrollBar::setMarks);
 
     _scrollbarHorizontal = new ScrollBar(this);
     QObject::connect(_file, &File::scrollPositionChanged, _scrollbarHorizontal, &ScrollBar::scrollPosition);
@@ -46,6 +53,20 @@ FileWindow::FileWindow(Tui::ZWidget *parent) : Tui::ZWindow(parent) {
             }
     );
 
+    QObject::connect(_file, &File::loadingFinished, this, [this](bool ok) {
+        if (!ok) {
+            readErrorAlert();
+        }
+        if (std::exchange(_followFileResume, false) && ok) {
+            setFollowFile(true);
+        }
+    });
+    QObject::connect(_file, &File::loadingCanceled, this, [this] {
+        // The document is incomplete, don't keep it associated with the file on disk.
+        newFile("");
+        _cmdReload->setEnabled(false);
+    });
+
     //Wrap
     QObject::connect(new Tui::ZCommandNotifier("Wrap", this, Qt::WindowShortcut), &Tui::ZCommandNotifier::activated,
                     this, &FileWindow::wrapDialog);
@@ -143,6 +164,19 @@ FileWindow::FileWindow(Tui::ZWidget *parent) : Tui::ZWindow(parent) {
         }
     );
 
+    _cmdFollowFile = new Tui::ZCommandNotifier("FollowFile", this, Qt::WindowShortcut);
+    _cmdFollowFile->setEnabled(false);
+    QObject::connect(_cmdFollowFile, &Tui::ZCommandNotifier::activated, this,
+         [this] {
+            setFollowFile(!_file->followFile());
+        }
+    );
+
+    // Not all changes trigger the watcher, e.g. after a log rotation the new file is not watched yet.
+    _followFileTimer = new QTimer(this);
+    _followFileTimer->setInterval(500);
+    QObject::connect(_followFileTimer, &QTimer::timeout, this, &FileWindow::followFileUpdate);
+
     QObject::connect(this, &FileWindow::readFromStandadInput, this, [this](bool enable) {
         _cmdInputPipe->setEnabled(enable);
         _cmdFollow->setEnabled(enable);
@@ -151,7 +185,11 @@ FileWindow::FileWindow(Tui::ZWidget *parent) : Tui::ZWindow(parent) {
 
     _watcher = new QFileSystemWatcher();
     QObject::connect(_watcher, &QFileSystemWatcher::fileChanged, this, [this] {
-        fileChangedExternally(true);
+        if (_file->followFile()) {
+            followFileUpdate();
+        } else {
+            fileChangedExternally(true);
+        }
     });
 
     _file->newText("");
@@ -234,6 +272,8 @@ SaveDialog *FileWindow::saveOrSaveas(std::function<void(bool)> callback) {
 
 void FileWindow::newFile(QString filename) {
     closePipe();
+    setFollowFile(false);
+    _cmdFollowFile->setEnabled(false);
     watcherRemove();
     _file->newText(filename);
     if (filename.size()) {
@@ -247,42 +287,42 @@ void FileWindow::newFile(QString filename) {
 
 void FileWindow::openFile(QString filename) {
     closePipe();
+    setFollowFile(false);
     watcherRemove();
-    if (!_file->openText(filename)) {
-        Alert *e = new Alert(parentWidget());
-        e->setWindowTitle("Error");
-        e->setMarkup("Error while reading file.");
-        e->setGeometry({15, 5, 50, 5});
-        e->setDefaultPlacement(Qt::AlignCenter);
-        e->setVisible(true);
-        e->setFocus();
+    if (!_file->openTextAsync(filename)) {
+        readErrorAlert();
     }
     backingFileChanged(_file->getFilename());
     fileChangedExternally(false);
     watcherAdd();
 
     _cmdReload->setEnabled(true);
+    _cmdFollowFile->setEnabled(true);
 }
 
 void FileWindow::reload() {
     closePipe();
+    setFollowFile(false);
     _file->clearSelection();
     Tui::ZDocumentCursor::Position cursorPosition = _file->cursorPosition();
     watcherRemove();
-    if (!_file->openText(_file->getFilename())) {
-        Alert *e = new Alert(parentWidget());
-        e->setWindowTitle("Error");
-        e->setMarkup("Error while reading file.");
-        e->setGeometry({15, 5, 50, 5});
-        e->setDefaultPlacement(Qt::AlignCenter);
-        e->setVisible(true);
-        e->setFocus();
+    if (!_file->openTextAsync(_file->getFilename(), cursorPosition)) {
+        readErrorAlert();
     }
     fileChangedExternally(false);
-    _file->setCursorPosition(cursorPosition);
     watcherAdd();
 }
 
+void FileWindow::readErrorAlert() {
+    Alert *e = new Alert(parentWidget());
+    e->setWindowTitle("Error");
+    e->setMarkup("Error while reading file.");
+    e->setGeometry({15, 5, 50, 5});
+    e->setDefaultPlacement(Qt::AlignCenter);
+    e->setVisible(true);
+    e->setFocus();
+}
+
 void FileWindow::closeEvent(Tui::ZCloseEvent *event) {
     if (!event->skipChecks().contains("unsaved")) {
         closeRequested();
@@ -400,54 +440,182 @@ void FileWindow::watcherRemove() {
 
 
 void FileWindow::closePipe() {
-    if (_pipeSocketNotifier != nullptr && _pipeSocketNotifier->isEnabled()) {
-        _pipeSocketNotifier->setEnabled(false);
-        _pipeSocketNotifier->deleteLater();
-        _pipeSocketNotifier = nullptr;
+    if (_pipeReader != nullptr) {
+        _pipeReader->stop();
+        _pipeReader->deleteLater();
+        _pipeReader = nullptr;
         ::close(0);
         readFromStandadInput(false);
     }
 }
 
 void FileWindow::watchPipe() {
-    _pipeSocketNotifier = new QSocketNotifier(0, QSocketNotifier::Type::Read, this);
-    QObject::connect(_pipeSocketNotifier, &QSocketNotifier::activated, this, &FileWindow::inputPipeReadable);
+    setFollowFile(false);
+    _cmdFollowFile->setEnabled(false);
+    _pipeReader = new PipeReader(0, this);
+    QObject::connect(_pipeReader, &PipeReader::batchesAvailable, this, &FileWindow::drainPipe);
     _file->stdinText();
     readFromStandadInput(true);
+    _pipeReader->start();
 }
 
 
-void FileWindow::inputPipeReadable(int socket) {
-    char buff[1024];
-    int bytes = read(socket, buff, 1024);
-    if (bytes == 0) {
-        // EOF
-        if (!_pipeLineBuffer.isEmpty()) {
-            _file->appendLine(Tui::Misc::SurrogateEscape::decode(_pipeLineBuffer));
+void FileWindow::drainPipe() {
+    if (_pipeReader == nullptr) {
+        return;
+    }
+
+    // Limit the time spent per event loop iteration, so that keyboard input and painting stay responsive
+    // with a fast producer. The remaining batches are taken in the next iteration.
+    const int budgetMs = 10;
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList lines;
+    bool eof = false;
+    bool more = false;
+    while (true) {
+        if (timer.elapsed() >= budgetMs) {
+            more = true;
+            break;
         }
-        _pipeSocketNotifier->deleteLater();
-        _pipeSocketNotifier = nullptr;
-    } else if (bytes < 0) {
-        // TODO error handling
-        _pipeSocketNotifier->deleteLater();
-        _pipeSocketNotifier = nullptr;
-    } else {
-        _pipeLineBuffer.append(buff, bytes);
-        int index;
-        while ((index = _pipeLineBuffer.indexOf('\n')) != -1) {
-            _file->appendLine(Tui::Misc::SurrogateEscape::decode(_pipeLineBuffer.left(index)));
-            _pipeLineBuffer = _pipeLineBuffer.mid(index + 1);
+        std::optional<PipeBatch> batch = _pipeReader->takeBatch();
+        if (!batch) {
+            break;
+        }
+        if (lines.isEmpty()) {
+            lines = std::move(batch->lines);
+        } else {
+            lines += batch->lines;
+        }
+        if (batch->eof) {
+            eof = true;
+            break;
         }
+    }
+
+    if (!lines.isEmpty()) {
+        _file->appendLines(lines);
         _file->modifiedChanged(true);
     }
 
-    if (_pipeSocketNotifier == nullptr) {
+    if (eof) {
+        _pipeReader->deleteLater();
+        _pipeReader = nullptr;
         readFromStandadInput(false);
+    } else if (more) {
+        QTimer::singleShot(0, this, &FileWindow::drainPipe);
+    }
+}
+
+
+void FileWindow::setFollowFile(bool follow) {
+    if (!follow) {
+        _followFileResume = false;
+    }
+    if (follow == _file->followFile()) {
+        return;
+    }
+    if (follow) {
+        if (_file->isLoading() || _file->isPaged() || _file->loadedFileSize() < 0) {
+            return;
+        }
+        if (_file->isModified()) {
+            // The additions to the file can not be merged with the edits.
+            Alert *e = new Alert(parentWidget());
+            e->setWindowTitle("Follow file");
+            e->setMarkup("The file has unsaved changes. Save or reload it before following it.");
+            e->setGeometry({15, 5, 50, 6});
+            e->setDefaultPlacement(Qt::AlignCenter);
+            e->setVisible(true);
+            e->setFocus();
+            return;
+        }
+        struct stat st;
+        if (::stat(_file->getFilename().toUtf8().constData(), &st) != 0) {
+            return;
+        }
+        if (st.st_ino != _file->loadedFileInode() || st.st_size < _file->loadedFileSize()) {
+            // Replaced or truncated since it was loaded, start over with the current content.
+            followFileReload();
+            return;
+        }
+        // Everything the file grew by since it was loaded is read by the first update.
+        _followFileInode = st.st_ino;
+        _followFileOffset = _file->loadedFileSize();
+        _followFilePending.clear();
+        fileChangedExternally(false);
+        _followFileTimer->start();
     } else {
-        readFromStandadInput(true);
+        _followFileTimer->stop();
+        _followFilePending.clear();
+    }
+    _file->setFollowFile(follow);
+    followFileChanged(follow);
+    if (follow) {
+        followFileUpdate();
     }
 }
 
+void FileWindow::followFileReload() {
+    setFollowFile(false);
+    // Set before loading, a file that is shown paged reports the end of loading right away (and is not followed).
+    _followFileResume = true;
+    watcherRemove();
+    if (!_file->openTextAsync(_file->getFilename())) {
+        _followFileResume = false;
+        readErrorAlert();
+    }
+    fileChangedExternally(false);
+    watcherAdd();
+}
+
+void FileWindow::followFileUpdate() {
+    if (!_file->followFile()) {
+        return;
+    }
+
+    const QString filename = _file->getFilename();
+    struct stat st;
+    if (::stat(filename.toUtf8().constData(), &st) != 0) {
+        // Might be in the middle of a rotation, try again later.
+        return;
+    }
+
+    if (st.st_ino != _followFileInode || st.st_size < _followFileOffset) {
+        // Rotated or truncated, the document has to start over with the content of the new file.
+        followFileReload();
+        return;
+    }
+
+    if (st.st_size == _followFileOffset) {
+        return;
+    }
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(_followFileOffset)) {
+        return;
+    }
+    const QByteArray data = file.read(st.st_size - _followFileOffset);
+    _followFileOffset += data.size();
+    _followFilePending += data;
+
+    // An incomplete last line is kept back until its line break was written.
+    const int lastNewline = _followFilePending.lastIndexOf('\n');
+    if (lastNewline < 0) {
+        return;
+    }
+    QString text = decodeText(_followFilePending.constData(), lastNewline);
+    const qint64 bytes = lastNewline + 1;
+    _followFilePending.remove(0, lastNewline + 1);
+    if (_file->document()->crLfMode()) {
+        text.replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+        if (text.endsWith('\r')) {
+            text.chop(1);
+        }
+    }
+    _file->appendFileText(text, bytes);
+}
 
 void FileWindow::setFollow(bool follow) {
     _follow = follow;
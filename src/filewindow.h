@@ -3,14 +3,18 @@
 #ifndef FILEWINDOW_H
 #define FILEWINDOW_H
 
+#include <sys/types.h>
+
 #include <functional>
 
-#include <QSocketNotifier>
+#include <QFileSystemWatcher>
+#include <QTimer>
 
 #include <Tui/ZWindow.h>
 #include <Tui/ZWindowLayout.h>
 
 #include "file.h"
+#include "pipereader.h"
 #include "savedialog.h"
 #include "scrollbar.h"
 #include "wrapdialog.h"
@@ -32,6 +36,7 @@ public:
     void watchPipe();
     void setFollow(bool follow);
     bool getFollow();
+    void setFollowFile(bool follow);
 
     SaveDialog *saveOrSaveas(std::function<void(bool)> callback = {});
 
@@ -40,6 +45,7 @@ signals:
     void followStandadInput(bool follow);
     void fileChangedExternally(bool fileChangedExternally);
     void backingFileChanged(QString filename);
+    void followFileChanged(bool follow);
 
 protected:
     void closeEvent(Tui::ZCloseEvent *event) override;
@@ -53,11 +59,14 @@ private:
     SaveDialog *saveFileDialog(std::function<void(bool)> callback = {});
     WrapDialog *wrapDialog();
     void reload();
+    void readErrorAlert();
 
     void watcherAdd();
     void watcherRemove();
 
-    void inputPipeReadable(int socket);
+    void drainPipe();
+    void followFileUpdate();
+    void followFileReload();
 
 private:
     File *_file = nullptr;
@@ -70,8 +79,14 @@ private:
     Tui::ZCommandNotifier *_cmdReload = nullptr;
     Tui::ZCommandNotifier *_cmdFollow = nullptr;
     Tui::ZCommandNotifier *_cmdInputPipe = nullptr;
-    QSocketNotifier *_pipeSocketNotifier = nullptr;
-    QByteArray _pipeLineBuffer;
+    Tui::ZCommandNotifier *_cmdFollowFile = nullptr;
+    QTimer *_followFileTimer = nullptr;
+    ino_t _followFileInode = 0;
+    qint64 _followFileOffset = 0;
+    QByteArray _followFilePending;
+    // Following is turned on again when the reload of a rotated or truncated file has finished.
+    bool _followFileResume = false;
+    PipeReader *_pipeReader = nullptr;
 };
 
 
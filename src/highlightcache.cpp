@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "highlightcache.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+static constexpr quint32 cacheMagic = 0x63687268; // "chrh"
+static constexpr quint32 cacheFormatVersion = 1;
+
+HighlightCache::HighlightCache(const QString &directory, qint64 maxSize)
+    : _directory(directory), _maxSize(maxSize) {
+}
+
+quint32 HighlightCache::lineHash(const QString &text) {
+    // FNV-1a, qHash() is not guaranteed to be stable between Qt versions or machines.
+    quint32 hash = 2166136261u;
+    for (const QChar ch : text) {
+        hash = (hash ^ ch.unicode()) * 16777619u;
+    }
+    // 0 is reserved for lines without cached highlighting.
+    return hash ? hash : 1;
+}
+
+QString HighlightCache::entryPath(const QString &filename) const {
+    const QByteArray key = QFileInfo(filename).absoluteFilePath().toUtf8();
+    return _directory + "/" + QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex() + ".hlc";
+}
+
+// A damaged entry must not make QDataStream allocate more than the entry can hold.
+static bool vectorFits(const QByteArray &data, qint64 pos, int elementSize) {
+    if (data.size() - pos < 4) {
+        return false;
+    }
+    const quint32 count = qFromBigEndian<quint32>(data.constData() + pos);
+    return count <= (data.size() - pos - 4) / elementSize;
+}
+
+std::optional<HighlightCacheEntry> HighlightCache::read(const QString &filename, const QString &definition) const {
+    QFile file(entryPath(filename));
+    if (!file.open(QIODevice::ReadOnly) || file.size() > _maxSize) {
+        return std::nullopt;
+    }
+    const QByteArray data = file.readAll();
+    // Mark as recently used for trim().
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    file.close();
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QDataStream stream(&buffer);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString storedFilename;
+    HighlightCacheEntry entry;
+    stream >> magic >> version;
+    if (magic != cacheMagic || version != cacheFormatVersion) {
+        return std::nullopt;
+    }
+    stream >> storedFilename >> entry.definition >> entry.formats;
+    if (stream.status() != QDataStream::Ok || storedFilename != QFileInfo(filename).absoluteFilePath()
+            || entry.definition != definition) {
+        return std::nullopt;
+    }
+
+    quint32 lineCount = 0;
+    stream >> lineCount;
+    if (lineCount > data.size() / 8) {
+        return std::nullopt;
+    }
+    entry.lineHashes.resize(lineCount);
+    entry.runs.resize(lineCount);
+    for (quint32 line = 0; line < lineCount; line++) {
+        stream >> entry.lineHashes[line];
+        if (!vectorFits(data, buffer.pos(), sizeof(quint64))) {
+            return std::nullopt;
+        }
+        stream >> entry.runs[line];
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+bool HighlightCache::write(const QString &filename, const HighlightCacheEntry &entry) {
+    if (_maxSize <= 0 || entry.lineHashes.size() != entry.runs.size()) {
+        return false;
+    }
+
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << cacheMagic << cacheFormatVersion << QFileInfo(filename).absoluteFilePath() << entry.definition
+               << entry.formats << quint32(entry.lineHashes.size());
+        for (int line = 0; line < entry.lineHashes.size(); line++) {
+            if (entry.lineHashes[line]) {
+                stream << entry.lineHashes[line] << entry.runs[line];
+            } else {
+                stream << quint32(0) << SyntaxRuns();
+            }
+        }
+    }
+    if (data.size() > _maxSize) {
+        return false;
+    }
+
+    if (!QDir().mkpath(_directory)) {
+        return false;
+    }
+    QSaveFile file(entryPath(filename));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        return false;
+    }
+
+    trim();
+    return true;
+}
+
+void HighlightCache::trim() {
+    // Newest first, the least recently used entries are removed from the end.
+    const QFileInfoList entries = QDir(_directory).entryInfoList({"*.hlc"}, QDir::Files, QDir::Time);
+    qint64 size = 0;
+    for (const QFileInfo &entry : entries) {
+        size += entry.size();
+        if (size > _maxSize) {
+            QFile::remove(entry.absoluteFilePath());
+        }
+    }
+}
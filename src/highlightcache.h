@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef HIGHLIGHTCACHE_H
+#define HIGHLIGHTCACHE_H
+
+#include <optional>
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "syntaxruns.h"
+
+// Highlighted ranges of one file as stored in the highlight cache.
+struct HighlightCacheEntry {
+    // Name and version of the syntax definition that produced the ranges.
+    QString definition;
+    // Format ids are only valid within one process, the cached ranges use indexes into this list instead.
+    QStringList formats;
+    // HighlightCache::lineHash() of each line, 0 for lines that had no highlighting when the entry was written.
+    QVector<quint32> lineHashes;
+    QVector<SyntaxRuns> runs;
+};
+
+// On-disk cache of the highlighted ranges of files, so that a file that is opened again can be shown with
+// highlighting before it is recomputed. Each file has one entry named after a hash of its path. When the entries
+// use more than maxSize bytes, the least recently used ones are removed.
+class HighlightCache {
+public:
+    HighlightCache(const QString &directory, qint64 maxSize);
+
+public:
+    static quint32 lineHash(const QString &text);
+
+    // Returns nothing if there is no readable entry for filename that was written with the same definition.
+    std::optional<HighlightCacheEntry> read(const QString &filename, const QString &definition) const;
+    bool write(const QString &filename, const HighlightCacheEntry &entry);
+
+private:
+    QString entryPath(const QString &filename) const;
+    void trim();
+
+private:
+    QString _directory;
+    qint64 _maxSize = 0;
+};
+
+#endif // HIGHLIGHTCACHE_H
@@ -69,7 +69,7 @@ int main(int argc, char **argv) {
 
     // big file
     QCommandLineOption bigOption({"b", "big-file"},
-                    QCoreApplication::translate("main", "Open bigger files than 100MB"));
+                    QCoreApplication::translate("main", "Load files bigger than 100MB for editing instead of read only paged view"));
     parser.addOption(bigOption);
 
     // wrap log lines
@@ -199,6 +199,13 @@ int main(int argc, char **argv) {
     settings.colorSpaceEnd = qsettings->value("color_space_end", "0").toBool();
 
     bool bigfile = qsettings->value("big_file", "false").toBool();
+    if (!bigfile && !parser.isSet(bigOption)) {
+        // Files of this size are shown in a read only paged view instead of loading them completely.
+        settings.pagedViewThreshold = qint64(100) * 1024 * 1024;
+    }
+
+    settings.stdinMaxLines = qsettings->value("stdin_max_lines", "0").toInt();
+    settings.stdinMaxBytes = qsettings->value("stdin_max_size", "0").toLongLong() * 1024 * 1024;
 
     QString defaultSyntaxHighlightingTheme;
     QString theme = qsettings->value("theme", "classic").toString();
@@ -219,6 +226,8 @@ int main(int argc, char **argv) {
     if (parser.isSet(disableSyntaxHighlighting)) {
         settings.disableSyntaxHighlighting = true;
     }
+    settings.syntaxHighlightingMemory = qsettings->value("syntax_highlighting_memory", "256").toLongLong() * 1024 * 1024;
+    settings.syntaxHighlightingCacheSize = qsettings->value("syntax_highlighting_cache", "64").toLongLong() * 1024 * 1024;
 #endif
 
     // default cache file
@@ -325,12 +334,6 @@ int main(int argc, char **argv) {
                 actions.push_back([root, name=fileInfo.absoluteFilePath()] { root->newFile(name); });
             } else if (filecategory == FileCategory::open_file) {
                 QFileInfo fileInfo(fle.fileName);
-                int maxMB = 100;
-                if (fileInfo.size() / 1024 / 1024 >= maxMB && !parser.isSet(bigOption) && !bigfile) {
-                    out << "The file is bigger then " << maxMB << "MB (" << fileInfo.size() / 1024 / 1024
-                        << "MB). Please start with -b for big files.\n";
-                    return 0;
-                }
                 actions.push_back([root, name=fileInfo.absoluteFilePath(), pos=fle.pos, search=fle.search] {
                     FileWindow* win = root->openFile(name);
                     if (search != "") {
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "mappedfile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <limits>
+
+#include <QtConcurrent>
+
+#include <Tui/Misc/SurrogateEscape.h>
+
+MappedFile::MappedFile() {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const QString &filename) {
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    _size = _file.size();
+    if (_size > 0) {
+        // Same heuristic as the document: The line ending of the first line decides.
+        const QByteArray start = bytes(0, 64 * 1024);
+        const int firstNewline = start.indexOf('\n');
+        _crLfMode = firstNewline > 0 && start[firstNewline - 1] == '\r';
+    }
+
+    _checkpoints.clear();
+    _checkpoints.push_back(0);
+    _lineCount = 0;
+    _indexComplete = false;
+    _cancel = false;
+    _indexFuture = QtConcurrent::run([this] {
+        buildIndex();
+    });
+
+    return true;
+}
+
+void MappedFile::close() {
+    _cancel = true;
+    _indexFuture.waitForFinished();
+
+    _file.close();
+    _size = 0;
+    _crLfMode = false;
+
+    {
+        std::lock_guard lock{_pageMutex};
+        _pages.clear();
+    }
+
+    std::lock_guard lock{_mutex};
+    _checkpoints.clear();
+    _lineCount = 0;
+    _indexComplete = false;
+}
+
+qint64 MappedFile::size() const {
+    return _size;
+}
+
+int MappedFile::lineCount() const {
+    return _lineCount;
+}
+
+bool MappedFile::indexComplete() const {
+    return _indexComplete;
+}
+
+bool MappedFile::crLfMode() const {
+    return _crLfMode;
+}
+
+bool MappedFile::newlineAfterLastLineMissing() const {
+    const qint64 size = _size;
+    return size > 0 && bytes(size - 1, 1) != "\n";
+}
+
+qint64 MappedFile::readAt(char *buffer, qint64 pos, qint64 length) const {
+    qint64 done = 0;
+    while (done < length) {
+        const ssize_t result = ::pread(_file.handle(), buffer + done, length - done, pos + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+void MappedFile::truncated(qint64 end) const {
+    // Reading past the new end does not tell where it is.
+    struct stat st;
+    if (::fstat(_file.handle(), &st) == 0) {
+        end = std::min<qint64>(end, st.st_size);
+    }
+    qint64 size = _size;
+    while (end < size && !_size.compare_exchange_weak(size, end)) {
+    }
+}
+
+std::shared_ptr<const QByteArray> MappedFile::page(qint64 index) const {
+    std::lock_guard lock{_pageMutex};
+    for (auto it = _pages.begin(); it != _pages.end(); ++it) {
+        if (it->first == index) {
+            _pages.splice(_pages.begin(), _pages, it);
+            return it->second;
+        }
+    }
+
+    const qint64 pos = index * pageSize;
+    const qint64 expected = std::max<qint64>(0, std::min(pageSize, _size - pos));
+    auto data = std::make_shared<QByteArray>(static_cast<int>(expected), Qt::Uninitialized);
+    const qint64 read = readAt(data->data(), pos, expected);
+    if (read < expected) {
+        truncated(pos + read);
+        data->resize(read);
+    }
+    _pages.emplace_front(index, data);
+    if (_pages.size() > maxPages) {
+        _pages.pop_back();
+    }
+    return data;
+}
+
+qint64 MappedFile::findNewline(qint64 pos, qint64 maxBytes) const {
+    const qint64 end = std::min<qint64>(_size, pos + maxBytes);
+    while (pos < end) {
+        const qint64 index = pos / pageSize;
+        const std::shared_ptr<const QByteArray> data = page(index);
+        const qint64 pageStart = index * pageSize;
+        const qint64 pageEnd = std::min(end, pageStart + data->size());
+        if (pageEnd <= pos) {
+            // truncated
+            return -1;
+        }
+        const char *begin = data->constData() + (pos - pageStart);
+        const char *found = static_cast<const char*>(memchr(begin, '\n', pageEnd - pos));
+        if (found) {
+            return pos + (found - begin);
+        }
+        pos = pageEnd;
+    }
+    return -1;
+}
+
+QByteArray MappedFile::bytes(qint64 pos, qint64 length) const {
+    QByteArray result;
+    const qint64 end = std::min<qint64>(_size, pos + length);
+    while (pos < end) {
+        const qint64 index = pos / pageSize;
+        const std::shared_ptr<const QByteArray> data = page(index);
+        const qint64 pageStart = index * pageSize;
+        const qint64 pageEnd = std::min(end, pageStart + data->size());
+        if (pageEnd <= pos) {
+            break;
+        }
+        result.append(data->constData() + (pos - pageStart), pageEnd - pos);
+        pos = pageEnd;
+    }
+    return result;
+}
+
+void MappedFile::buildIndex() {
+    // Publish progress in chunks, so that the lock is not taken for every line.
+    const qint64 chunkSize = 16 * 1024 * 1024;
+    // Read separately from the pages, those are for the lines that are shown.
+    QByteArray buffer(static_cast<int>(std::min<qint64>(chunkSize, _size)), Qt::Uninitialized);
+
+    std::vector<qint64> pending;
+    int lines = 0;
+    qint64 pos = 0;
+    char lastByte = '\n';
+    bool full = false;
+
+    while (pos < _size && !full) {
+        if (_cancel) {
+            return;
+        }
+
+        const qint64 chunkLength = std::min<qint64>(_size - pos, chunkSize);
+        const qint64 read = readAt(buffer.data(), pos, chunkLength);
+        if (read < chunkLength) {
+            truncated(pos + read);
+        }
+        const char *data = buffer.constData();
+        qint64 offset = 0;
+        while (offset < read) {
+            const char *found = static_cast<const char*>(memchr(data + offset, '\n', read - offset));
+            if (!found) {
+                break;
+            }
+            offset = found - data + 1;
+            if (lines == std::numeric_limits<int>::max() - 1) {
+                // The rest of the file can not be addressed by line number anymore.
+                full = true;
+                break;
+            }
+            lines++;
+            if (lines % indexStride == 0) {
+                pending.push_back(pos + offset);
+            }
+        }
+        if (read > 0) {
+            lastByte = data[read - 1];
+        }
+        pos += read;
+
+        {
+            std::lock_guard lock{_mutex};
+            _checkpoints.insert(_checkpoints.end(), pending.begin(), pending.end());
+            _lineCount = lines;
+        }
+        pending.clear();
+        if (pos < _size && !full) {
+            indexProgress(lines, false);
+        }
+    }
+
+    if (_size == 0 || (!full && lastByte != '\n')) {
+        // last line without line break
+        lines++;
+    }
+
+    _lineCount = lines;
+    _indexComplete = true;
+    indexProgress(lines, true);
+}
+
+qint64 MappedFile::lineStart(int line) const {
+    qint64 start = 0;
+    {
+        std::lock_guard lock{_mutex};
+        const size_t checkpoint = line / indexStride;
+        if (checkpoint >= _checkpoints.size()) {
+            return -1;
+        }
+        start = _checkpoints[checkpoint];
+    }
+
+    for (int i = line % indexStride; i > 0; i--) {
+        const qint64 found = findNewline(start, _size - start);
+        if (found < 0) {
+            return -1;
+        }
+        start = found + 1;
+    }
+    return start;
+}
+
+QString MappedFile::decodeLine(qint64 start) const {
+    const qint64 size = _size;
+    if (start >= size) {
+        return QString();
+    }
+    const qint64 available = std::min(size - start, maxLineBytes);
+    const qint64 found = findNewline(start, available);
+    QByteArray text = bytes(start, found >= 0 ? found - start : available);
+    if (found >= 0 && _crLfMode && text.endsWith('\r')) {
+        text.chop(1);
+    }
+    return Tui::Misc::SurrogateEscape::decode(text);
+}
+
+QString MappedFile::line(int line) const {
+    if (line < 0 || line >= lineCount()) {
+        return QString();
+    }
+    const qint64 start = lineStart(line);
+    if (start < 0 || start > _size) {
+        return QString();
+    }
+    return decodeLine(start);
+}
+
+QStringList MappedFile::lines(int first, int count) const {
+    QStringList result;
+
+    first = std::max(0, first);
+    count = std::min(count, lineCount() - first);
+    if (count <= 0) {
+        return result;
+    }
+
+    qint64 start = lineStart(first);
+    if (start < 0) {
+        return result;
+    }
+
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        if (start >= _size) {
+            // empty last line
+            result.append(QString());
+            break;
+        }
+        result.append(decodeLine(start));
+        const qint64 found = findNewline(start, _size - start);
+        if (found < 0) {
+            break;
+        }
+        start = found + 1;
+    }
+    return result;
+}
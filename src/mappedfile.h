@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <QFile>
+#include <QFuture>
+#include <QObject>
+#include <QStringList>
+
+// Read only view of a file that is too big to be loaded into a ZDocument. The line offsets are indexed in a
+// background thread, lines are only read and decoded when requested. The file is read in pages instead of being
+// mapped into memory: big files are often logs that get truncated while shown, and touching a mapping past the
+// new end of the file would kill the editor with SIGBUS. A truncated file just ends early.
+class MappedFile : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MappedFile();
+    ~MappedFile();
+
+public:
+    bool open(const QString &filename);
+    void close();
+
+    qint64 size() const;
+    // Number of lines indexed so far, grows until indexComplete() is true.
+    int lineCount() const;
+    bool indexComplete() const;
+    bool crLfMode() const;
+    bool newlineAfterLastLineMissing() const;
+
+    QString line(int line) const;
+    QStringList lines(int first, int count) const;
+
+signals:
+    void indexProgress(int lineCount, bool complete);
+
+private:
+    void buildIndex();
+    qint64 lineStart(int line) const;
+    QString decodeLine(qint64 start) const;
+    // Reads with pread, fewer bytes at the end of the file.
+    qint64 readAt(char *buffer, qint64 pos, qint64 length) const;
+    // The file got shorter than it was when opened, it ends at end or earlier.
+    void truncated(qint64 end) const;
+    std::shared_ptr<const QByteArray> page(qint64 index) const;
+    // Position of the next line break in [pos, pos + maxBytes), -1 if there is none.
+    qint64 findNewline(qint64 pos, qint64 maxBytes) const;
+    QByteArray bytes(qint64 pos, qint64 length) const;
+
+private:
+    // Only every indexStride'th line start is stored, the other lines are found by scanning from there.
+    static constexpr int indexStride = 64;
+    // Lines longer than this are cut off to keep memory usage bounded.
+    static constexpr qint64 maxLineBytes = 1024 * 1024;
+    // Recently read parts of the file are kept in up to maxPages pages of pageSize bytes.
+    static constexpr qint64 pageSize = 256 * 1024;
+    static constexpr size_t maxPages = 64;
+
+    QFile _file;
+    mutable std::atomic<qint64> _size = 0;
+    bool _crLfMode = false;
+
+    mutable std::mutex _pageMutex;
+    // Most recently used first.
+    mutable std::list<std::pair<qint64, std::shared_ptr<const QByteArray>>> _pages;
+
+    mutable std::mutex _mutex;
+    std::vector<qint64> _checkpoints;
+    std::atomic<int> _lineCount = 0;
+    std::atomic<bool> _indexComplete = false;
+    std::atomic<bool> _cancel = false;
+    QFuture<void> _indexFuture;
+};
+
+#endif // MAPPEDFILE_H
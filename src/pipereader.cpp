@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "pipereader.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <Tui/Misc/SurrogateEscape.h>
+
+#include "textdecoder.h"
+
+PipeReader::PipeReader(int fd, QObject *parent) : QThread(parent), _fd(fd) {
+    _wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+PipeReader::~PipeReader() {
+    stop();
+    if (_wakeFd >= 0) {
+        ::close(_wakeFd);
+    }
+}
+
+std::optional<PipeBatch> PipeReader::takeBatch() {
+    std::optional<PipeBatch> batch = _queue.pop();
+    if (!batch) {
+        // Re-arm the notification. A batch pushed just before this did not emit batchesAvailable, so check again.
+        _notifyPending = false;
+        batch = _queue.pop();
+    }
+    if (batch) {
+        _freeSlots.release();
+    }
+    return batch;
+}
+
+void PipeReader::stop() {
+    _stop = true;
+    // Wake the thread if it waits for a free slot or for the pipe.
+    _freeSlots.release();
+    if (_wakeFd >= 0) {
+        eventfd_write(_wakeFd, 1);
+    }
+    wait();
+}
+
+void PipeReader::pushBatch(PipeBatch &&batch) {
+    // There is always space, a slot was reserved with _freeSlots before reading.
+    _queue.push(std::move(batch));
+    if (!_notifyPending.exchange(true)) {
+        batchesAvailable();
+    }
+}
+
+// Number of bytes at the start of data up to size, that do not end in the middle of a UTF-8 sequence.
+static int utf8CutPosition(const char *data, int size) {
+    for (int cut = size; cut > 0 && cut > size - 4; cut--) {
+        if ((data[cut] & 0xc0) != 0x80) {
+            return cut;
+        }
+    }
+    // Not valid UTF-8 anyway.
+    return size;
+}
+
+void PipeReader::run() {
+    QByteArray buffer;
+
+    // Only without the eventfd, stop() is then noticed with this interval.
+    const int stopCheckMs = _wakeFd >= 0 ? -1 : 100;
+
+    while (!_stop) {
+        // Do not read more than can be queued, this leaves the data in the pipe.
+        _freeSlots.acquire();
+        if (_stop) {
+            break;
+        }
+
+        pollfd pfds[2] = {{_fd, POLLIN, 0}, {_wakeFd, POLLIN, 0}};
+        int pollResult = 0;
+        while (!_stop && (pollResult = poll(pfds, 2, stopCheckMs)) == 0) {
+        }
+        if (_stop) {
+            _freeSlots.release();
+            break;
+        }
+        if (pollResult < 0 && errno == EINTR) {
+            _freeSlots.release();
+            continue;
+        }
+
+        const int oldSize = buffer.size();
+        buffer.resize(oldSize + readSize);
+        const ssize_t bytes = pollResult < 0 ? -1 : read(_fd, buffer.data() + oldSize, readSize);
+        if (bytes < 0 && errno == EINTR) {
+            buffer.resize(oldSize);
+            _freeSlots.release();
+            continue;
+        }
+        buffer.resize(oldSize + std::max<ssize_t>(bytes, 0));
+
+        PipeBatch batch;
+        if (bytes <= 0) {
+            // EOF or read error, the last line has no line break
+            if (!buffer.isEmpty()) {
+                batch.lines.append(Tui::Misc::SurrogateEscape::decode(buffer));
+            }
+            batch.eof = true;
+            pushBatch(std::move(batch));
+            return;
+        }
+
+        // Only the newly read part can contain new line breaks.
+        const char *data = buffer.constData();
+        const char *lastNewline = static_cast<const char*>(memrchr(data + oldSize, '\n', bytes));
+        if (!lastNewline) {
+            if (buffer.size() < maxLineBytes) {
+                _freeSlots.release();
+                continue;
+            }
+            // The producer does not write line breaks, hand over what is there as a line of its own.
+            const int cut = utf8CutPosition(data, maxLineBytes);
+            batch.lines.append(decodeText(data, cut));
+            buffer.remove(0, cut);
+            pushBatch(std::move(batch));
+            continue;
+        }
+        const int completeBytes = lastNewline - data;
+        batch.lines = decodeText(data, completeBytes).split('\n');
+        buffer.remove(0, completeBytes + 1);
+        pushBatch(std::move(batch));
+    }
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef PIPEREADER_H
+#define PIPEREADER_H
+
+#include <atomic>
+#include <optional>
+
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+
+#include "spscqueue.h"
+
+struct PipeBatch {
+    QStringList lines;
+    // Set on the last batch, after end of file or a read error.
+    bool eof = false;
+};
+
+// Reads and decodes lines from a pipe in its own thread. Decoded batches are handed over in a bounded queue,
+// when the queue is full the thread stops reading so that the writer of the pipe is blocked by the kernel.
+class PipeReader : public QThread {
+    Q_OBJECT
+
+public:
+    explicit PipeReader(int fd, QObject *parent = nullptr);
+    ~PipeReader();
+
+public:
+    // Called from the thread that owns the reader. Each call frees one slot in the queue.
+    std::optional<PipeBatch> takeBatch();
+    // Wakes the thread and waits until it has finished.
+    void stop();
+
+public:
+    // Input without a line break is handed over in lines of at most this size, so that it can not grow the
+    // buffer without bound.
+    static constexpr int maxLineBytes = 1024 * 1024;
+
+signals:
+    // Emitted when a batch was added after takeBatch found the queue empty.
+    void batchesAvailable();
+
+protected:
+    void run() override;
+
+private:
+    void pushBatch(PipeBatch &&batch);
+
+private:
+    static constexpr int queueCapacity = 64;
+    static constexpr int readSize = 64 * 1024;
+
+    const int _fd;
+    // eventfd that is signaled by stop(), it is polled together with _fd.
+    int _wakeFd = -1;
+    SpscQueue<PipeBatch> _queue{queueCapacity};
+    QSemaphore _freeSlots{queueCapacity};
+    std::atomic<bool> _stop = false;
+    std::atomic<bool> _notifyPending = false;
+};
+
+#endif // PIPEREADER_H
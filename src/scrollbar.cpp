@@ -2,6 +2,8 @@
 
 #include "scrollbar.h"
 
+#include <algorithm>
+
 #include <QRect>
 
 #include <Tui/ZColor.h>
@@ -81,6 +83,13 @@ void ScrollBar::paintEvent(Tui::ZPaintEvent *event) {
             }
             y += 1;
         }
+        for (double mark: _marks) {
+            const int markY = 1 + std::min(trackBarSize - 1, static_cast<int>(mark * trackBarSize));
+            const bool onThumb = markY > trackBarPosition && markY <= trackBarPosition + thumbHeight;
+            const Tui::ZColor markBg = onThumb ? (_transparent ? thumbBgColor : controlbg)
+                                               : (_transparent ? trackBgColor : bg);
+            painter->writeWithColors(0, markY, "■", {0xff, 0xdd, 0}, markBg);
+        }
         painter->writeWithColors(0, trackBarSize + 1, "↓", controlfg, controlbg);
     } else {
         if (!_transparent) {
@@ -118,6 +127,11 @@ void ScrollBar::setTransparent(bool transparent) {
     _transparent = transparent;
 }
 
+void ScrollBar::setMarks(QVector<double> marks) {
+    _marks = marks;
+    update();
+}
+
 void ScrollBar::scrollPosition(int x, int y) {
     if (_autoHideEnabled && _scrollPositionY != y) {
         setVisible(true);
@@ -4,6 +4,7 @@
 #define SCROLLBAR_H
 
 #include <QTimer>
+#include <QVector>
 
 #include <Tui/ZWidget.h>
 
@@ -20,6 +21,8 @@ public slots:
     void positonMax(int x, int y);
     void setAutoHide(bool val);
     void setTransparent(bool transparent);
+    // Positions relative to the whole range to mark on the track, e.g. search matches.
+    void setMarks(QVector<double> marks);
 
 protected:
     void paintEvent(Tui::ZPaintEvent *event);
@@ -36,6 +39,7 @@ private:
     QTimer _autoHide;
     bool _autoHideEnabled = false;
     bool _transparent = false;
+    QVector<double> _marks;
 };
 
 #endif // SCROLLBAR_H
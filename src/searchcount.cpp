@@ -2,19 +2,274 @@
 
 #include "searchcount.h"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrent>
+
 #include <Tui/ZDocumentSnapshot.h>
 
-SearchCount::SearchCount() {
+namespace {
+    struct Search {
+        Tui::ZDocumentSnapshot snap;
+        // Appends the matches that start in a line.
+        std::function<void(int, QVector<SearchMatch>&)> matchesInLine;
+        // Number of lines after the line it starts in that a match can cover.
+        int extraLines = 0;
+        int gen = 0;
+        std::shared_ptr<std::atomic<int>> searchGen;
 
+        bool canceled() const {
+            return gen != *searchGen;
+        }
+    };
 }
 
-void SearchCount::run(Tui::ZDocumentSnapshot snap, QString searchText, Qt::CaseSensitivity caseSensitivity, int gen, std::shared_ptr<std::atomic<int>> searchGen) {
-    int found = 0;
-    for (int line = 0; line < snap.lineCount(); line++) {
-        if (gen != *searchGen) {
-            return;
+// Returns std::nullopt for an invalid regular expression.
+static std::optional<Search> prepareSearch(Tui::ZDocumentSnapshot snap, const QString &searchText,
+                                           Qt::CaseSensitivity caseSensitivity, bool regex, int gen,
+                                           std::shared_ptr<std::atomic<int>> searchGen) {
+    Search search;
+    search.snap = snap;
+    search.gen = gen;
+    search.searchGen = searchGen;
+
+    const QStringList parts = searchText.split('\n');
+    if (regex) {
+        QRegularExpression rx(searchText);
+        if (caseSensitivity == Qt::CaseInsensitive) {
+            rx.setPatternOptions(QRegularExpression::PatternOption::CaseInsensitiveOption);
+        }
+        if (!rx.isValid()) {
+            return std::nullopt;
+        }
+        // Compile (with JIT where available) once, instead of in whichever worker thread matches first.
+        rx.optimize();
+        search.matchesInLine = [snap, rx](int line, QVector<SearchMatch> &matches) {
+            QRegularExpressionMatchIterator it = rx.globalMatch(snap.line(line));
+            while (it.hasNext()) {
+                QRegularExpressionMatch match = it.next();
+                // empty matches are not shown as matches either
+                if (match.capturedLength() > 0) {
+                    matches.append(SearchMatch{{match.capturedStart(), line}, {match.capturedEnd(), line}});
+                }
+            }
+        };
+    } else if (parts.size() > 1) {
+        // A match starts at the end of a line, covers all lines in between completely and ends at the start of
+        // a following line, so there is at most one match starting in each line.
+        search.extraLines = parts.size() - 1;
+        search.matchesInLine = [snap, parts, caseSensitivity](int line, QVector<SearchMatch> &matches) {
+            const int lastLine = line + parts.size() - 1;
+            if (lastLine >= snap.lineCount()) {
+                return;
+            }
+            const QString firstText = snap.line(line);
+            if (!firstText.endsWith(parts.first(), caseSensitivity)) {
+                return;
+            }
+            for (int i = 1; i < parts.size() - 1; i++) {
+                if (snap.line(line + i).compare(parts[i], caseSensitivity) != 0) {
+                    return;
+                }
+            }
+            if (snap.line(lastLine).startsWith(parts.last(), caseSensitivity)) {
+                matches.append(SearchMatch{{firstText.size() - parts.first().size(), line},
+                                           {parts.last().size(), lastLine}});
+            }
+        };
+    } else {
+        search.matchesInLine = [snap, searchText, caseSensitivity](int line, QVector<SearchMatch> &matches) {
+            const QString text = snap.line(line);
+            int found = -1;
+            while ((found = text.indexOf(searchText, found + 1, caseSensitivity)) != -1) {
+                matches.append(SearchMatch{{found, line}, {found + searchText.size(), line}});
+            }
+        };
+    }
+    return search;
+}
+
+// Searches the lines first to last - 1 in chunks on all cores and returns the number of matches starting there,
+// or -1 when canceled. The matches are appended to matches unless there are more than maxIndexedMatches
+// together with alreadyFound. With progress the count so far is reported every progressInterval milliseconds.
+static int collect(SearchCount *sc, const Search &search, int first, int last, int alreadyFound, bool progress,
+                   QVector<SearchMatch> &matches) {
+    struct Chunk {
+        int begin = 0;
+        int end = 0;
+        QVector<SearchMatch> matches;
+    };
+
+    const int chunkLines = std::max(1000, (last - first) / (QThread::idealThreadCount() * 4));
+    QVector<Chunk> chunks;
+    for (int begin = first; begin < last; begin += chunkLines) {
+        chunks.append(Chunk{begin, std::min(begin + chunkLines, last), {}});
+    }
+
+    std::atomic<int> found = 0;
+    std::atomic<bool> tooMany = false;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    std::atomic<qint64> nextProgress = SearchCount::progressInterval;
+
+    // Whichever thread notices first that the interval has passed sends the progress.
+    auto reportProgress = [&] {
+        const qint64 now = elapsed.elapsed();
+        qint64 due = nextProgress;
+        if (now >= due && nextProgress.compare_exchange_strong(due, now + SearchCount::progressInterval)
+                && !search.canceled()) {
+            sc->searchCount(alreadyFound + found, false);
+        }
+    };
+
+    QtConcurrent::blockingMap(chunks, [&](Chunk &chunk) {
+        // Added to found every 256 lines instead of every line, all threads would be writing to it.
+        int unflushed = 0;
+        for (int line = chunk.begin; line < chunk.end; line++) {
+            if (search.canceled()) {
+                return;
+            }
+            const int before = chunk.matches.size();
+            search.matchesInLine(line, chunk.matches);
+            unflushed += chunk.matches.size() - before;
+            if (tooMany || alreadyFound + found + unflushed > SearchCount::maxIndexedMatches) {
+                // Only counted from here on.
+                tooMany = true;
+                chunk.matches.resize(0);
+            }
+            if (line % 256 == 255) {
+                found += std::exchange(unflushed, 0);
+                if (progress) {
+                    reportProgress();
+                }
+            }
+        }
+        found += unflushed;
+    });
+
+    if (search.canceled()) {
+        return -1;
+    }
+    if (!tooMany) {
+        for (const Chunk &chunk: chunks) {
+            matches.append(chunk.matches);
         }
-        found += snap.line(line).count(searchText, caseSensitivity);
-        searchCount(found);
     }
+    return found;
+}
+
+static QVector<unsigned> lineRevisions(const Tui::ZDocumentSnapshot &snap) {
+    QVector<unsigned> revisions;
+    revisions.reserve(snap.lineCount());
+    for (int line = 0; line < snap.lineCount(); line++) {
+        revisions.append(snap.lineRevision(line));
+    }
+    return revisions;
+}
+
+SearchCount::SearchCount() {
+
+}
+
+void SearchCount::run(Tui::ZDocumentSnapshot snap, QString searchText, Qt::CaseSensitivity caseSensitivity, bool regex, int gen, std::shared_ptr<std::atomic<int>> searchGen) {
+    std::optional<Search> search = prepareSearch(snap, searchText, caseSensitivity, regex, gen, searchGen);
+    if (!search) {
+        searchCount(-1, true);
+        searchIndex(nullptr);
+        return;
+    }
+
+    auto index = std::make_shared<SearchIndex>();
+    const int found = collect(this, *search, 0, snap.lineCount(), 0, true, index->matches);
+    if (found < 0) {
+        searchIndex(nullptr);
+        return;
+    }
+
+    searchCount(found, true);
+    if (found > maxIndexedMatches) {
+        searchIndex(nullptr);
+        return;
+    }
+    index->generation = gen;
+    index->documentRevision = snap.revision();
+    index->lineRevisions = lineRevisions(snap);
+    searchIndex(index);
+}
+
+void SearchCount::update(Tui::ZDocumentSnapshot snap, std::shared_ptr<const SearchIndex> previous, QString searchText, Qt::CaseSensitivity caseSensitivity, bool regex, int gen, std::shared_ptr<std::atomic<int>> searchGen) {
+    if (!previous) {
+        run(snap, searchText, caseSensitivity, regex, gen, searchGen);
+        return;
+    }
+
+    std::optional<Search> search = prepareSearch(snap, searchText, caseSensitivity, regex, gen, searchGen);
+    if (!search) {
+        searchCount(-1, true);
+        searchIndex(nullptr);
+        return;
+    }
+
+    auto index = std::make_shared<SearchIndex>();
+    index->generation = gen;
+    index->documentRevision = snap.revision();
+    index->lineRevisions = lineRevisions(snap);
+
+    // The lines that changed are between the unchanged lines at the start and at the end of the document.
+    const QVector<unsigned> &before = previous->lineRevisions;
+    const QVector<unsigned> &after = index->lineRevisions;
+    const int common = std::min(before.size(), after.size());
+    int unchangedStart = 0;
+    while (unchangedStart < common && before[unchangedStart] == after[unchangedStart]) {
+        unchangedStart++;
+    }
+    int unchangedEnd = 0;
+    while (unchangedEnd < common - unchangedStart
+           && before[before.size() - 1 - unchangedEnd] == after[after.size() - 1 - unchangedEnd]) {
+        unchangedEnd++;
+    }
+
+    // Matches that start shortly before a changed line can cover it, so these lines are searched again too.
+    const int first = std::max(0, unchangedStart - search->extraLines);
+    const int last = after.size() - unchangedEnd;
+    const int previousLast = before.size() - unchangedEnd;
+    const int shift = last - previousLast;
+
+    auto startsBefore = [](const SearchMatch &match, int line) {
+        return match.start.line < line;
+    };
+    const auto keptStart = std::lower_bound(previous->matches.begin(), previous->matches.end(), first, startsBefore);
+    const auto keptEnd = std::lower_bound(keptStart, previous->matches.end(), previousLast, startsBefore);
+    const int keptStartCount = keptStart - previous->matches.begin();
+    const int keptEndCount = previous->matches.end() - keptEnd;
+
+    index->matches.reserve(keptStartCount + keptEndCount);
+    std::copy(previous->matches.begin(), keptStart, std::back_inserter(index->matches));
+
+    const int found = collect(this, *search, first, last, keptStartCount, false, index->matches);
+    if (found < 0) {
+        searchIndex(nullptr);
+        return;
+    }
+
+    const int total = keptStartCount + found + keptEndCount;
+    searchCount(total, true);
+    if (total > maxIndexedMatches) {
+        searchIndex(nullptr);
+        return;
+    }
+    for (auto it = keptEnd; it != previous->matches.end(); ++it) {
+        SearchMatch match = *it;
+        match.start.line += shift;
+        match.end.line += shift;
+        index->matches.append(match);
+    }
+    searchIndex(index);
 }
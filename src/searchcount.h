@@ -5,25 +5,60 @@
 
 #include <memory>
 
+#include <QMetaType>
 #include <QObject>
 #include <QVector>
 
 #include <Tui/ZDocument.h>
+#include <Tui/ZDocumentCursor.h>
+
+struct SearchMatch {
+    Tui::ZDocumentCursor::Position start;
+    Tui::ZDocumentCursor::Position end;
+};
+
+// All matches of a search in one revision of a document, sorted by position.
+struct SearchIndex {
+    int generation = 0;
+    unsigned documentRevision = 0;
+    // Revision of every line, to find the lines that changed since.
+    QVector<unsigned> lineRevisions;
+    QVector<SearchMatch> matches;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<const SearchIndex>);
 
 class SearchCount : public QObject {
     Q_OBJECT
 
 public:
     explicit SearchCount();
-    void run(Tui::ZDocumentSnapshot snap, QString searchText, Qt::CaseSensitivity caseSensitivity, int gen, std::shared_ptr<std::atomic<int>> searchGen);
+    // Counts in chunks of lines on all cores. The count so far is reported every progressInterval milliseconds,
+    // the final count once at the end. Nothing is reported anymore once searchGen no longer is gen.
+    // With regex the matches of the regular expression within each line are counted, an invalid expression is
+    // reported as -1. Otherwise searchText may contain line breaks to match across lines.
+    // searchIndex is emitted at the end in any case, without index when canceled or with more than
+    // maxIndexedMatches matches.
+    void run(Tui::ZDocumentSnapshot snap, QString searchText, Qt::CaseSensitivity caseSensitivity, bool regex, int gen, std::shared_ptr<std::atomic<int>> searchGen);
+    // Like run, but only searches the lines that changed since previous was built and takes the other matches
+    // from previous. Only the final count is reported.
+    void update(Tui::ZDocumentSnapshot snap, std::shared_ptr<const SearchIndex> previous, QString searchText, Qt::CaseSensitivity caseSensitivity, bool regex, int gen, std::shared_ptr<std::atomic<int>> searchGen);
+
+public:
+    static constexpr int progressInterval = 50;
+    static constexpr int maxIndexedMatches = 1000000;
+
 signals:
-    void searchCount(int sc);
+    // Emitted from worker threads.
+    void searchCount(int sc, bool complete);
+    void searchIndex(std::shared_ptr<const SearchIndex> index);
 };
 
 class SearchCountSignalForwarder : public QObject {
     Q_OBJECT
 signals:
-    void searchCount(int count);
+    void searchCount(int count, bool complete);
+    void searchIndex(std::shared_ptr<const SearchIndex> index);
 };
 
 #endif // SEARCHCOUNT_H
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <optional>
+#include <vector>
+
+// Bounded lock free queue for exactly one producer thread and one consumer thread.
+template<typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : _slots(capacity + 1) {
+    }
+
+public:
+    // Returns false if the queue is full, value is not moved from in that case.
+    bool push(T &&value) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) % _slots.size();
+        if (next == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _slots[tail] = std::move(value);
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> pop() {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        std::optional<T> value = std::move(_slots[head]);
+        _slots[head] = T();
+        _head.store((head + 1) % _slots.size(), std::memory_order_release);
+        return value;
+    }
+
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return _slots.size() - 1;
+    }
+
+private:
+    std::vector<T> _slots;
+    // Only written by the consumer.
+    alignas(64) std::atomic<size_t> _head = 0;
+    // Only written by the producer.
+    alignas(64) std::atomic<size_t> _tail = 0;
+};
+
+#endif // SPSCQUEUE_H
@@ -91,6 +91,11 @@ void StatusBar::followStandardInput(bool follow) {
     update();
 }
 
+void StatusBar::followFile(bool follow) {
+    _followFile = follow;
+    update();
+}
+
 QString StatusBar::viewStandardInput() {
     QString text;
     if (_stdin) {
@@ -118,8 +123,14 @@ QString StatusBar::viewReadWrite() {
     return text;
 }
 
-void StatusBar::searchCount(int sc) {
+void StatusBar::searchCount(int sc, bool complete) {
     _searchCount = sc;
+    _searchCountComplete = complete;
+    update();
+}
+
+void StatusBar::searchMatch(int number) {
+    _searchMatch = number;
     update();
 }
 
@@ -204,6 +215,8 @@ QString StatusBar::viewOverwrite() {
 QString StatusBar::viewLanguage() {
     if (!_syntaxHighlightingEnabled || _language == "None") {
         return "";
+    } else if (_syntaxHighlightingDegraded) {
+        return _language + " PARTIAL";
     } else {
         return _language;
     }
@@ -224,6 +237,22 @@ void StatusBar::language(QString language) {
     update();
 }
 
+void StatusBar::loadingProgress(qint64 bytesRead, qint64 bytesTotal, int lines) {
+    _loadingBytesRead = bytesRead;
+    _loadingBytesTotal = bytesTotal;
+    _loadingLines = lines;
+    update();
+}
+
+QString StatusBar::viewLoading() {
+    if (_loadingBytesRead < 0) {
+        return "";
+    }
+    const qint64 mb = 1024 * 1024;
+    return "LOADING " + QString::number(_loadingBytesRead / mb) + "/" + QString::number(_loadingBytesTotal / mb) + "MB "
+            + QString::number(_loadingLines) + "L (Esc)";
+}
+
 void StatusBar::notifyQtLog() {
     _qtMessage = true;
 }
@@ -233,6 +262,11 @@ void StatusBar::syntaxHighlightingEnabled(bool enable) {
     update();
 }
 
+void StatusBar::syntaxHighlightingDegraded(bool degraded) {
+    _syntaxHighlightingDegraded = degraded;
+    update();
+}
+
 
 QString slash(QString text) {
     if (text != "") {
@@ -251,9 +285,11 @@ void StatusBar::paintEvent(Tui::ZPaintEvent *event) {
     QString search;
     int cutColums = terminal()->textMetrics().splitByColumns(_searchText, 25).codeUnits;
     search = _searchText.left(cutColums).replace(u'\n', escapedNewLine).replace(u'\t', escapedTab)
-            + ": "+ QString::number(_searchCount);
+            + ": " + (_searchMatch > 0 ? QString::number(_searchMatch) + "/" : QString())
+            + QString::number(_searchCount) + (_searchCountComplete ? "" : "…");
 
     QString text;
+    text += slash(viewLoading());
     text += slash(viewSelectCharsLines());
     text += slash(viewLanguage());
     text += slash(viewFileChanged());
@@ -264,6 +300,9 @@ void StatusBar::paintEvent(Tui::ZPaintEvent *event) {
         text += slash(viewStandardInput());
     } else {
         text += slash(viewReadWrite());
+        if (_followFile) {
+            text += " FOLLOW";
+        }
     }
 
     text += slash(viewOverwrite());
@@ -24,6 +24,7 @@ public:
     QString viewSelectCharsLines();
     QString viewStandardInput();
     QString viewLanguage();
+    QString viewLoading();
     void switchToNormalDisplay();
 
 public:
@@ -35,8 +36,10 @@ public slots:
     void setModified(bool modifiedFile);
     void readFromStandardInput(bool activ);
     void followStandardInput(bool follow);
+    void followFile(bool follow);
     void setWritable(bool rw);
-    void searchCount(int sc);
+    void searchCount(int sc, bool complete);
+    void searchMatch(int number);
     void searchText(QString searchText);
     void searchVisible(bool visible);
     void crlfMode(bool msdos);
@@ -45,7 +48,9 @@ public slots:
     void fileHasBeenChangedExternally(bool fileChanged = true);
     void overwrite(bool overwrite);
     void syntaxHighlightingEnabled(bool enable);
+    void syntaxHighlightingDegraded(bool degraded);
     void language(QString language);
+    void loadingProgress(qint64 bytesRead, qint64 bytesTotal, int lines);
 
 public:
     static void notifyQtLog();
@@ -66,8 +71,11 @@ private:
     int _scrollPositionY = 0;
     bool _stdin = false;
     bool _follow = false;
+    bool _followFile = false;
     bool _readwrite = true;
     int _searchCount = -1;
+    bool _searchCountComplete = true;
+    int _searchMatch = 0;
     QString _searchText = "";
     bool _searchVisible = false;
     bool _crlfMode = false;
@@ -78,6 +86,10 @@ private:
     bool _overwrite = false;
     QString _language = "None";
     bool _syntaxHighlightingEnabled = false;
+    bool _syntaxHighlightingDegraded = false;
+    qint64 _loadingBytesRead = -1;
+    qint64 _loadingBytesTotal = -1;
+    int _loadingLines = 0;
     Tui::ZColor _bg;
 
     static bool _qtMessage;
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "syntaxdetect.h"
+
+#include <algorithm>
+
+#include <QFileInfo>
+#include <QRegularExpression>
+
+static SyntaxHint modelineHint(const QString &line) {
+    // kate: hl Python; indent-width 4;
+    static const QRegularExpression kate(QStringLiteral("kate:.*\\b(?:hl|syntax)\\s+([^;]+);?"));
+    // vim: set ft=python : or vi: syntax=sh
+    static const QRegularExpression vim(QStringLiteral("(?:^|\\s)(?:vim?|ex):.*\\b(?:ft|filetype|syn|syntax)=([\\w+-]+)"));
+    // -*- mode: python -*- or -*- python -*-
+    static const QRegularExpression emacsMode(QStringLiteral("-\\*-.*\\bmode:\\s*([\\w+-]+).*-\\*-"));
+    static const QRegularExpression emacs(QStringLiteral("-\\*-\\s*([\\w+-]+)\\s*-\\*-"));
+
+    SyntaxHint hint;
+    QRegularExpressionMatch match = kate.match(line);
+    if (match.hasMatch()) {
+        hint.name = match.captured(1).trimmed();
+        return hint;
+    }
+    match = vim.match(line);
+    if (match.hasMatch()) {
+        hint.name = match.captured(1);
+        return hint;
+    }
+    match = emacsMode.match(line);
+    if (!match.hasMatch()) {
+        match = emacs.match(line);
+    }
+    if (match.hasMatch()) {
+        hint.name = match.captured(1);
+    }
+    return hint;
+}
+
+static SyntaxHint shebangHint(const QString &line) {
+    SyntaxHint hint;
+    if (!line.startsWith(QStringLiteral("#!"))) {
+        return hint;
+    }
+
+    const QString command = line.mid(2).simplified();
+    if (command.isEmpty()) {
+        return hint;
+    }
+    QStringList words = command.split(QLatin1Char(' '));
+    if (words.size() && QFileInfo(words[0]).fileName() == QStringLiteral("env")) {
+        words.removeFirst();
+        // env options like -S, and variable assignments
+        while (words.size() && (words[0].startsWith(QLatin1Char('-')) || words[0].contains(QLatin1Char('=')))) {
+            words.removeFirst();
+        }
+    }
+    if (words.isEmpty()) {
+        return hint;
+    }
+
+    // python3.11 -> python
+    static const QRegularExpression version(QStringLiteral("[\\d.]+$"));
+    QString interpreter = QFileInfo(words[0]).fileName();
+    interpreter.remove(version);
+
+    static const QList<QPair<QStringList, QString>> filenames = {
+        {{"sh", "bash", "dash", "ksh", "mksh", "ash"}, "script.sh"},
+        {{"zsh"}, "script.zsh"},
+        {{"fish"}, "script.fish"},
+        {{"python", "pypy"}, "script.py"},
+        {{"perl"}, "script.pl"},
+        {{"ruby"}, "script.rb"},
+        {{"node", "nodejs"}, "script.js"},
+        {{"php"}, "script.php"},
+        {{"lua", "luajit"}, "script.lua"},
+        {{"tclsh", "wish", "expect"}, "script.tcl"},
+        {{"awk", "gawk", "mawk", "nawk"}, "script.awk"},
+        {{"make", "gmake"}, "Makefile"},
+        {{"Rscript"}, "script.r"},
+        {{"julia"}, "script.jl"},
+    };
+    for (const auto &[interpreters, filename]: filenames) {
+        if (interpreters.contains(interpreter)) {
+            hint.filename = filename;
+            return hint;
+        }
+    }
+    hint.name = interpreter;
+    return hint;
+}
+
+static SyntaxHint contentHint(const QStringList &head) {
+    SyntaxHint hint;
+    QStringList lines;
+    for (const QString &line: head) {
+        if (!line.trimmed().isEmpty()) {
+            lines.append(line);
+        }
+    }
+    if (lines.isEmpty()) {
+        return hint;
+    }
+
+    const QString &first = lines[0];
+    if (first.startsWith(QStringLiteral("<?xml"))) {
+        hint.name = QStringLiteral("XML");
+    } else if (first.startsWith(QStringLiteral("<!DOCTYPE html"), Qt::CaseInsensitive)
+               || first.startsWith(QStringLiteral("<html"), Qt::CaseInsensitive)) {
+        hint.name = QStringLiteral("HTML");
+    } else if (first.startsWith(QStringLiteral("diff ")) || first.startsWith(QStringLiteral("Index: "))
+               || (first.startsWith(QStringLiteral("--- ")) && lines.size() > 1
+                   && lines[1].startsWith(QStringLiteral("+++ ")))) {
+        hint.name = QStringLiteral("Diff");
+    } else if (first.startsWith(QStringLiteral("From ")) && first.contains(QLatin1Char('@'))) {
+        // git format-patch
+        hint.name = QStringLiteral("Email");
+    } else {
+        static const QRegularExpression section(QStringLiteral("^\\s*\\[[^\\]]+\\]\\s*$"));
+        static const QRegularExpression comment(QStringLiteral("^\\s*[#;]"));
+        for (const QString &line: lines) {
+            if (comment.match(line).hasMatch()) {
+                continue;
+            }
+            if (section.match(line).hasMatch()) {
+                hint.name = QStringLiteral("INI Files");
+            }
+            break;
+        }
+    }
+    if (!hint.isEmpty()) {
+        return hint;
+    }
+
+    // Logs: most lines start with a date and time, e.g. "2024-05-01 12:00:00" or syslog's "May  1 12:00:00".
+    static const QRegularExpression timestamp(QStringLiteral(
+        "^\\[?(?:\\d{4}-\\d{2}-\\d{2}[ T]\\d{2}:\\d{2}|[A-Z][a-z]{2} [ \\d]\\d \\d{2}:\\d{2}:\\d{2})"));
+    int timestamps = 0;
+    const int checked = std::min<int>(lines.size(), 10);
+    for (int i = 0; i < checked; i++) {
+        if (timestamp.match(lines[i]).hasMatch()) {
+            timestamps++;
+        }
+    }
+    if (timestamps * 2 > checked) {
+        hint.name = QStringLiteral("Log File (simplified)");
+    }
+    return hint;
+}
+
+SyntaxHint detectSyntaxHint(const QStringList &head, const QStringList &tail) {
+    auto limited = [](const QString &line) {
+        return line.left(syntaxDetectMaxLineLength);
+    };
+
+    // Modelines are explicit, they are allowed in the first and last lines. Vim only looks at 5 of each.
+    QStringList modelineCandidates;
+    for (int i = 0; i < std::min<int>(head.size(), syntaxDetectTailLines); i++) {
+        modelineCandidates.append(limited(head[i]));
+    }
+    for (const QString &line: tail) {
+        modelineCandidates.append(limited(line));
+    }
+    for (const QString &line: modelineCandidates) {
+        const SyntaxHint hint = modelineHint(line);
+        if (!hint.isEmpty()) {
+            return hint;
+        }
+    }
+
+    if (head.isEmpty()) {
+        return {};
+    }
+
+    const SyntaxHint hint = shebangHint(limited(head[0]).trimmed());
+    if (!hint.isEmpty()) {
+        return hint;
+    }
+
+    QStringList lines;
+    for (int i = 0; i < std::min<int>(head.size(), syntaxDetectHeadLines); i++) {
+        lines.append(limited(head[i]));
+    }
+    return contentHint(lines);
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef SYNTAXDETECT_H
+#define SYNTAXDETECT_H
+
+#include <QString>
+#include <QStringList>
+
+// What the content of a file tells about its syntax definition, for files whose name does not.
+struct SyntaxHint {
+    // Definition name or file type as written in modelines, e.g. "Python" or "python".
+    QString name;
+    // A file name with the usual extension of the detected language, e.g. "script.py" for a python shebang.
+    QString filename;
+
+    bool isEmpty() const { return name.isEmpty() && filename.isEmpty(); }
+};
+
+// Only this many lines from the start and the end of a file are looked at.
+constexpr int syntaxDetectHeadLines = 64;
+constexpr int syntaxDetectTailLines = 5;
+// Longer lines are cut off before they are looked at.
+constexpr int syntaxDetectMaxLineLength = 1024;
+
+// Looks for modelines (kate, vim and emacs), a shebang and well known file headers, in this order.
+// head are the first and tail the last lines of the file.
+SyntaxHint detectSyntaxHint(const QStringList &head, const QStringList &tail);
+
+#endif // SYNTAXDETECT_H
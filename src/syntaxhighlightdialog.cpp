@@ -12,15 +12,15 @@
 
 #ifdef SYNTAX_HIGHLIGHTING
 #include <KSyntaxHighlighting/Definition>
-#include <KSyntaxHighlighting/Repository>
 #endif
 
+#include "syntaxrepository.h"
+
 static QStringList getAvailableLanguages () {
     QStringList availableLanguages;
 
 #ifdef SYNTAX_HIGHLIGHTING
-    KSyntaxHighlighting::Repository repo;
-    for (const auto &def : repo.definitions()) {
+    for (const auto &def : syntaxRepository().definitions()) {
       availableLanguages.append(def.name());
     }
 #endif
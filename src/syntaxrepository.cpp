@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "syntaxrepository.h"
+
+#ifdef SYNTAX_HIGHLIGHTING
+
+#include <algorithm>
+
+#include <QHash>
+
+KSyntaxHighlighting::Repository &syntaxRepository() {
+    static KSyntaxHighlighting::Repository repository;
+    return repository;
+}
+
+KSyntaxHighlighting::Definition definitionForSyntaxHint(const SyntaxHint &hint) {
+    KSyntaxHighlighting::Repository &repository = syntaxRepository();
+    if (!hint.filename.isEmpty()) {
+        const KSyntaxHighlighting::Definition definition = repository.definitionForFileName(hint.filename);
+        if (definition.isValid()) {
+            return definition;
+        }
+    }
+    if (hint.name.isEmpty()) {
+        return KSyntaxHighlighting::Definition();
+    }
+
+    const KSyntaxHighlighting::Definition definition = repository.definitionForName(hint.name);
+    if (definition.isValid()) {
+        return definition;
+    }
+    // File types in vim and emacs modelines are lower case names or the usual file extension.
+    const QVector<KSyntaxHighlighting::Definition> definitions = repository.definitions();
+    for (const KSyntaxHighlighting::Definition &candidate: definitions) {
+        if (candidate.name().compare(hint.name, Qt::CaseInsensitive) == 0) {
+            return candidate;
+        }
+    }
+    return repository.definitionForFileName("file." + hint.name);
+}
+
+SyntaxDefinitionLock::SyntaxDefinitionLock(std::vector<std::shared_ptr<std::mutex>> mutexes)
+    : _mutexes(std::move(mutexes))
+{
+    // A consistent order for all locks avoids deadlocks between definitions including each other.
+    std::sort(_mutexes.begin(), _mutexes.end());
+    _mutexes.erase(std::unique(_mutexes.begin(), _mutexes.end()), _mutexes.end());
+}
+
+void SyntaxDefinitionLock::lock() const {
+    for (const auto &mutex: _mutexes) {
+        mutex->lock();
+    }
+}
+
+bool SyntaxDefinitionLock::try_lock() const {
+    for (size_t i = 0; i < _mutexes.size(); i++) {
+        if (!_mutexes[i]->try_lock()) {
+            while (i > 0) {
+                _mutexes[--i]->unlock();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void SyntaxDefinitionLock::unlock() const {
+    for (auto it = _mutexes.rbegin(); it != _mutexes.rend(); ++it) {
+        (*it)->unlock();
+    }
+}
+
+std::shared_ptr<const SyntaxDefinitionLock> syntaxDefinitionLock(const KSyntaxHighlighting::Definition &definition) {
+    static QHash<QString, std::shared_ptr<std::mutex>> mutexes;
+    auto mutexFor = [](const KSyntaxHighlighting::Definition &def) {
+        std::shared_ptr<std::mutex> &mutex = mutexes[def.name()];
+        if (!mutex) {
+            mutex = std::make_shared<std::mutex>();
+        }
+        return mutex;
+    };
+    std::vector<std::shared_ptr<std::mutex>> locks = {mutexFor(definition)};
+    for (const KSyntaxHighlighting::Definition &included: definition.includedDefinitions()) {
+        locks.push_back(mutexFor(included));
+    }
+    return std::make_shared<SyntaxDefinitionLock>(std::move(locks));
+}
+
+#endif
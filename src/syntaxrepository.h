@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef SYNTAXREPOSITORY_H
+#define SYNTAXREPOSITORY_H
+
+#ifdef SYNTAX_HIGHLIGHTING
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <KSyntaxHighlighting/Definition>
+#include <KSyntaxHighlighting/Repository>
+
+#include "syntaxdetect.h"
+
+// The syntax definitions and themes, shared by all windows. Created on first use, the definitions themselves
+// are only parsed when they are used. Only use from the main thread.
+KSyntaxHighlighting::Repository &syntaxRepository();
+
+// Definition for a result of detectSyntaxHint(), an invalid definition if there is none. Only use from the main
+// thread.
+KSyntaxHighlighting::Definition definitionForSyntaxHint(const SyntaxHint &hint);
+
+// Loading a definition (see Definition::includedDefinitions()) does not prepare everything, some rules (e.g.
+// regular expressions) are only prepared when they are matched first. That is not safe from several threads
+// at once, so all highlighting with a definition holds this lock. It consists of one mutex for the definition
+// and one for every definition it includes, as these are shared with other definitions that include them.
+class SyntaxDefinitionLock {
+public:
+    explicit SyntaxDefinitionLock(std::vector<std::shared_ptr<std::mutex>> mutexes);
+
+public:
+    template <typename F>
+    auto run(F highlight) const {
+        std::lock_guard lock{*this};
+        return highlight();
+    }
+    // Like run, but does not wait while another thread highlights with one of the definitions.
+    template <typename F>
+    auto tryRun(F highlight) const -> std::optional<decltype(highlight())> {
+        std::unique_lock lock{*this, std::try_to_lock};
+        if (!lock.owns_lock()) {
+            return std::nullopt;
+        }
+        return highlight();
+    }
+
+    void lock() const;
+    bool try_lock() const;
+    void unlock() const;
+
+private:
+    // Always locked in this order.
+    std::vector<std::shared_ptr<std::mutex>> _mutexes;
+};
+
+// Lock for a definition and the definitions it includes, these have to be loaded already. Definitions are
+// identified by name, so all windows using a definition share its lock. Only use from the main thread.
+std::shared_ptr<const SyntaxDefinitionLock> syntaxDefinitionLock(const KSyntaxHighlighting::Definition &definition);
+
+#endif
+
+#endif // SYNTAXREPOSITORY_H
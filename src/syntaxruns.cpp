@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "syntaxruns.h"
+
+#include <algorithm>
+
+static quint64 pack(int offset, int length, quint16 formatId) {
+    return (quint64(quint32(offset)) << 32) | (quint64(length) << 16) | formatId;
+}
+
+void SyntaxRuns::append(int offset, int length, quint16 formatId) {
+    if (offset < 0 || length <= 0) {
+        return;
+    }
+
+    if (_runs.size()) {
+        const SyntaxFormatRange last = at(_runs.size() - 1);
+        if (last.formatId == formatId && last.offset + last.length == offset && last.length < maxRunLength) {
+            const int merged = std::min(maxRunLength - last.length, length);
+            _runs.last() = pack(last.offset, last.length + merged, formatId);
+            offset += merged;
+            length -= merged;
+        }
+    }
+
+    while (length > 0) {
+        const int runLength = std::min(maxRunLength, length);
+        _runs.append(pack(offset, runLength, formatId));
+        offset += runLength;
+        length -= runLength;
+    }
+}
+
+void SyntaxRuns::clear() {
+    _runs.clear();
+}
+
+void SyntaxRuns::squeeze() {
+    _runs.squeeze();
+}
+
+bool SyntaxRuns::isEmpty() const {
+    return _runs.isEmpty();
+}
+
+int SyntaxRuns::size() const {
+    return _runs.size();
+}
+
+SyntaxFormatRange SyntaxRuns::at(int i) const {
+    const quint64 run = _runs.at(i);
+    SyntaxFormatRange range;
+    range.offset = int(run >> 32);
+    range.length = int((run >> 16) & 0xffff);
+    range.formatId = quint16(run & 0xffff);
+    return range;
+}
+
+qint64 SyntaxRuns::memoryUsage() const {
+    if (!_runs.capacity()) {
+        return 0;
+    }
+    return sizeof(QArrayData) + _runs.capacity() * sizeof(quint64);
+}
+
+bool SyntaxRuns::operator==(const SyntaxRuns &other) const {
+    return _runs == other._runs;
+}
+
+bool SyntaxRuns::operator!=(const SyntaxRuns &other) const {
+    return _runs != other._runs;
+}
+
+QDataStream &operator<<(QDataStream &stream, const SyntaxRuns &runs) {
+    return stream << runs._runs;
+}
+
+QDataStream &operator>>(QDataStream &stream, SyntaxRuns &runs) {
+    stream >> runs._runs;
+    runs._runs.squeeze();
+    return stream;
+}
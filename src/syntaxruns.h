@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef SYNTAXRUNS_H
+#define SYNTAXRUNS_H
+
+#include <QDataStream>
+#include <QVector>
+
+// Highlighted range of a line. The format is stored as KSyntaxHighlighting::Format::id(), the colors for the
+// current theme are looked up when painting.
+struct SyntaxFormatRange {
+    int offset = 0;
+    int length = 0;
+    quint16 formatId = 0;
+};
+
+// Highlighted ranges of one line, each packed into 64 bits: offset (32 bits), length (16 bits) and format id
+// (16 bits). Adjacent ranges with the same format are merged, longer ranges are split. Lines without highlights
+// do not allocate.
+class SyntaxRuns {
+public:
+    void append(int offset, int length, quint16 formatId);
+    void clear();
+    void squeeze();
+    bool isEmpty() const;
+    int size() const;
+    SyntaxFormatRange at(int i) const;
+    // Heap memory used by the runs in bytes.
+    qint64 memoryUsage() const;
+
+    bool operator==(const SyntaxRuns &other) const;
+    bool operator!=(const SyntaxRuns &other) const;
+
+    friend QDataStream &operator<<(QDataStream &stream, const SyntaxRuns &runs);
+    friend QDataStream &operator>>(QDataStream &stream, SyntaxRuns &runs);
+
+private:
+    static constexpr int maxRunLength = 0xffff;
+
+    QVector<quint64> _runs;
+};
+
+#endif // SYNTAXRUNS_H
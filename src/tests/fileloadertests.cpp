@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "../fileloader.h"
+
+TEST_CASE("fileloader") {
+    QTemporaryDir dir;
+    QString filename = dir.path() + "/file";
+    std::atomic<bool> cancel = false;
+
+    auto writeFile = [&](const QByteArray &content) {
+        QFile file(filename);
+        REQUIRE(file.open(QIODevice::WriteOnly));
+        file.write(content);
+        file.close();
+    };
+
+    SECTION("empty") {
+        writeFile("");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == "");
+        CHECK(result.lineCount == 1);
+        CHECK(result.newlineAfterLastLineMissing == true);
+        CHECK(result.crLfMode == false);
+    }
+
+    SECTION("newline at end") {
+        writeFile("a\nbb\nccc\n");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == "a\nbb\nccc");
+        CHECK(result.lineCount == 3);
+        CHECK(result.newlineAfterLastLineMissing == false);
+        CHECK(result.crLfMode == false);
+    }
+
+    SECTION("no newline at end") {
+        writeFile("a\nbb\nccc");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == "a\nbb\nccc");
+        CHECK(result.lineCount == 3);
+        CHECK(result.newlineAfterLastLineMissing == true);
+    }
+
+    SECTION("crlf") {
+        writeFile("a\r\nbb\r\n");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == "a\nbb");
+        CHECK(result.crLfMode == true);
+        CHECK(result.newlineAfterLastLineMissing == false);
+    }
+
+    SECTION("mixed line endings") {
+        writeFile("a\r\nbb\n");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == "a\r\nbb");
+        CHECK(result.crLfMode == false);
+    }
+
+    SECTION("invalid utf8") {
+        writeFile("a\xff" "b\n");
+        LoadedText result = loadText(filename, cancel, {});
+        REQUIRE(result.ok);
+        CHECK(result.text == QString("a") + QChar(0xdcff) + QString("b"));
+    }
+
+    SECTION("multi chunk") {
+        // lines and multi byte sequences cross the boundaries of the 4MiB read chunks
+        QByteArray line = "äöü0123456789\n";
+        QByteArray content;
+        while (content.size() < 9 * 1024 * 1024) {
+            content += line;
+        }
+        writeFile(content);
+        int progressLines = -1;
+        LoadedText result = loadText(filename, cancel, [&](qint64 bytesRead, qint64 bytesTotal, int lines) {
+            CHECK(bytesRead <= bytesTotal);
+            progressLines = lines;
+        });
+        REQUIRE(result.ok);
+        const int expectedLines = content.size() / line.size();
+        CHECK(result.lineCount == expectedLines);
+        CHECK(progressLines == expectedLines);
+        CHECK(result.text.size() == expectedLines * (QString::fromUtf8(line).size()) - 1);
+        CHECK(result.text.count("äöü0123456789") == expectedLines);
+    }
+
+    SECTION("canceled") {
+        writeFile("a\n");
+        cancel = true;
+        LoadedText result = loadText(filename, cancel, {});
+        CHECK(!result.ok);
+    }
+
+    SECTION("missing file") {
+        LoadedText result = loadText(dir.path() + "/missing", cancel, {});
+        CHECK(!result.ok);
+    }
+}
@@ -1265,6 +1265,36 @@ TEST_CASE("actions") {
         CHECK(f->cursorPosition() == Tui::ZDocumentCursor::Position{12,1});
         recorder.clearEvents();
     }
+
+    SECTION("replace-regex") {
+        EventRecorder recorder;
+        auto cursorSignal = recorder.watchSignal(f, RECORDER_SIGNAL(&File::cursorPositionChanged));
+        f->setRegex(true);
+
+        CHECK(f->replaceAll("(\\w)(\\w)", "\\2\\1") == 4);
+        recorder.waitForEvent(cursorSignal);
+        CHECK(doc.line(0) == "    ettx");
+        CHECK(doc.line(1) == "    en1w");
+        CHECK(f->cursorPosition() == Tui::ZDocumentCursor::Position{8,1});
+
+        // all replacements are one undo step
+        f->undo();
+        CHECK(doc.line(0) == "    text");
+        CHECK(doc.line(1) == "    new1");
+    }
+
+    SECTION("replace-line-break") {
+        EventRecorder recorder;
+        auto cursorSignal = recorder.watchSignal(f, RECORDER_SIGNAL(&File::cursorPositionChanged));
+
+        CHECK(f->replaceAll("ext", "e\nxt") == 1);
+        recorder.waitForEvent(cursorSignal);
+        CHECK(doc.lineCount() == 3);
+        CHECK(doc.line(0) == "    te");
+        CHECK(doc.line(1) == "xt");
+        CHECK(doc.line(2) == "    new1");
+        CHECK(f->cursorPosition() == Tui::ZDocumentCursor::Position{2,1});
+    }
 }
 
 TEST_CASE("multiline") {
@@ -1438,3 +1468,106 @@ TEST_CASE("multiline") {
     }
 }
 
+
+TEST_CASE("appendLines") {
+    Tui::ZTerminal::OffScreen of(80, 24);
+    Tui::ZTerminal terminal(of);
+    Tui::ZRoot root;
+    Tui::ZWindow *w = new Tui::ZWindow(&root);
+    terminal.setMainWidget(&root);
+    w->setGeometry({0, 0, 80, 24});
+
+    File *f = new File(terminal.textMetrics(), w);
+    f->setFocus();
+    f->setGeometry({0, 0, 80, 24});
+
+    DocumentTestHelper t;
+    Tui::ZDocument &doc = t.getDoc(f);
+
+    SECTION("empty-document") {
+        f->appendLines({"abc", "def"});
+        CHECK(doc.lineCount() == 2);
+        CHECK(doc.line(0) == "abc");
+        CHECK(doc.line(1) == "def");
+        CHECK(f->cursorPosition() == Tui::ZDocumentCursor::Position{0,0});
+    }
+
+    SECTION("append") {
+        f->insertText("abc");
+        f->appendLines({"def"});
+        f->appendLines({"ghi", "", "jkl"});
+        CHECK(doc.lineCount() == 5);
+        CHECK(doc.line(0) == "abc");
+        CHECK(doc.line(1) == "def");
+        CHECK(doc.line(2) == "ghi");
+        CHECK(doc.line(3) == "");
+        CHECK(doc.line(4) == "jkl");
+    }
+
+    SECTION("nothing") {
+        f->appendLines({});
+        CHECK(doc.lineCount() == 1);
+        CHECK(doc.line(0) == "");
+    }
+
+    SECTION("stdin-max-lines") {
+        f->stdinText();
+        f->setStandardInputLimits(80, 0);
+        for (int i = 0; i < 100; i++) {
+            f->appendLines({QString::number(i)});
+        }
+        // trimmed back to 80 lines when the 91st line arrived
+        CHECK(doc.lineCount() == 89);
+        CHECK(doc.line(0) == "11");
+        CHECK(doc.line(88) == "99");
+    }
+
+    SECTION("stdin-trim-is-an-edit") {
+        f->stdinText();
+        f->setStandardInputLimits(80, 0);
+        for (int i = 0; i < 90; i++) {
+            f->appendLines({QString::number(i)});
+        }
+        f->setCursorPosition({1, 50});
+        f->appendLines({"90"});
+        CHECK(doc.lineCount() == 80);
+        CHECK(doc.line(0) == "11");
+        CHECK(f->cursorPosition() == Tui::ZDocumentCursor::Position{1, 39});
+        // The dropped lines can be brought back
+        f->undo();
+        CHECK(doc.lineCount() == 91);
+        CHECK(doc.line(0) == "0");
+        CHECK(doc.line(90) == "90");
+    }
+
+    SECTION("stdin-max-size") {
+        f->stdinText();
+        // 100 code units of text, each line has 9 code units and a line break
+        f->setStandardInputLimits(0, 200);
+        for (int i = 0; i < 12; i++) {
+            f->appendLines({QString("line%1____").arg(i % 10)});
+        }
+        CHECK(doc.lineCount() == 10);
+        CHECK(doc.line(0) == "line2____");
+        CHECK(doc.line(9) == "line1____");
+    }
+
+    SECTION("file-text-continues-last-line") {
+        f->insertText("abc\nde");
+        doc.setNewlineAfterLastLineMissing(true);
+        f->appendFileText("f\nghi");
+        CHECK(doc.lineCount() == 3);
+        CHECK(doc.line(1) == "def");
+        CHECK(doc.line(2) == "ghi");
+        CHECK(doc.newlineAfterLastLineMissing() == false);
+    }
+
+    SECTION("file-text-new-line") {
+        f->insertText("abc");
+        doc.setNewlineAfterLastLineMissing(false);
+        f->appendFileText("def");
+        CHECK(doc.lineCount() == 2);
+        CHECK(doc.line(0) == "abc");
+        CHECK(doc.line(1) == "def");
+    }
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include "../highlightcache.h"
+
+static HighlightCacheEntry testEntry(int lines) {
+    HighlightCacheEntry entry;
+    entry.definition = "C++ 12";
+    entry.formats = QStringList{"C++/Normal Text", "C++/Keyword"};
+    for (int line = 0; line < lines; line++) {
+        SyntaxRuns runs;
+        runs.append(0, 3, 1);
+        runs.append(3, line + 1, 0);
+        entry.lineHashes.append(HighlightCache::lineHash("int x" + QString::number(line)));
+        entry.runs.append(runs);
+    }
+    return entry;
+}
+
+TEST_CASE("highlightcache-linehash") {
+    CHECK(HighlightCache::lineHash("") != 0);
+    CHECK(HighlightCache::lineHash("abc") == HighlightCache::lineHash("abc"));
+    CHECK(HighlightCache::lineHash("abc") != HighlightCache::lineHash("abd"));
+}
+
+TEST_CASE("highlightcache-roundtrip") {
+    QTemporaryDir dir;
+    HighlightCache cache(dir.path() + "/highlight", 1024 * 1024);
+    const QString filename = dir.path() + "/file.cpp";
+
+    HighlightCacheEntry entry = testEntry(10);
+    // A line that was not highlighted when writing.
+    entry.lineHashes[4] = 0;
+    REQUIRE(cache.write(filename, entry));
+
+    std::optional<HighlightCacheEntry> read = cache.read(filename, "C++ 12");
+    REQUIRE(read.has_value());
+    CHECK(read->formats == entry.formats);
+    CHECK(read->lineHashes == entry.lineHashes);
+    REQUIRE(read->runs.size() == 10);
+    CHECK(read->runs[3] == entry.runs[3]);
+    CHECK(read->runs[4].isEmpty());
+
+    SECTION("other definition") {
+        CHECK(!cache.read(filename, "C++ 13").has_value());
+    }
+
+    SECTION("other file") {
+        CHECK(!cache.read(dir.path() + "/other.cpp", "C++ 12").has_value());
+    }
+
+    SECTION("damaged") {
+        const QStringList files = QDir(dir.path() + "/highlight").entryList({"*.hlc"}, QDir::Files);
+        REQUIRE(files.size() == 1);
+        QFile file(dir.path() + "/highlight/" + files[0]);
+        REQUIRE(file.open(QIODevice::ReadWrite));
+        file.resize(file.size() - 20);
+        file.close();
+        CHECK(!cache.read(filename, "C++ 12").has_value());
+    }
+}
+
+TEST_CASE("highlightcache-lru") {
+    QTemporaryDir dir;
+    const QString cacheDir = dir.path() + "/highlight";
+    const HighlightCacheEntry entry = testEntry(100);
+    const QString first = dir.path() + "/first";
+    const QString second = dir.path() + "/second";
+    const QString third = dir.path() + "/third";
+
+    // Measure the size of one entry.
+    HighlightCache unlimited(cacheDir, 1024 * 1024);
+    REQUIRE(unlimited.write(first, entry));
+    const QStringList files = QDir(cacheDir).entryList({"*.hlc"}, QDir::Files);
+    REQUIRE(files.size() == 1);
+    const qint64 entrySize = QFileInfo(cacheDir + "/" + files[0]).size();
+
+    HighlightCache cache(cacheDir, entrySize * 2 + entrySize / 2);
+    REQUIRE(cache.write(second, entry));
+
+    // Make first the most recently used entry, file times are not precise enough to rely on the order of writes.
+    for (const QString &name: QDir(cacheDir).entryList({"*.hlc"}, QDir::Files)) {
+        QFile file(cacheDir + "/" + name);
+        REQUIRE(file.open(QIODevice::ReadOnly));
+        file.setFileTime(QDateTime::currentDateTime().addSecs(-100), QFileDevice::FileModificationTime);
+    }
+    REQUIRE(cache.read(first, entry.definition).has_value());
+
+    REQUIRE(cache.write(third, entry));
+    CHECK(cache.read(first, entry.definition).has_value());
+    CHECK(!cache.read(second, entry.definition).has_value());
+    CHECK(cache.read(third, entry.definition).has_value());
+
+    SECTION("too big") {
+        HighlightCache tiny(cacheDir, entrySize / 2);
+        CHECK(!tiny.write(dir.path() + "/fourth", entry));
+    }
+}
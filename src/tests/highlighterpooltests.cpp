@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#ifdef SYNTAX_HIGHLIGHTING
+
+#include <QtConcurrent>
+
+#include <KSyntaxHighlighting/Repository>
+
+#include "../file.h"
+
+static QStringList cppLines(int count) {
+    const QStringList patterns = {
+        "#include <vector>",
+        "#define MAX(a, b) ((a) > (b) ? (a) : (b))",
+        "/** Doxygen @brief comment with <b>markup</b> */",
+        "/* a block comment",
+        "   that ends here */ int x = 0x1f + 017 + 1.5e-3f;",
+        "const char *s = \"string with \\\"escape\\\" and %d\";",
+        "auto r = R\"raw(text \" in raw string)raw\";",
+        "template <typename T> class Foo : public Bar<T> {",
+        "    // TODO: line comment",
+        "    if (x >= 42 && y != 'c') { return nullptr; }",
+        "};",
+        "#if defined(FOO) && !defined(BAR)",
+        "#endif",
+    };
+    QStringList lines;
+    for (int line = 0; line < count; line++) {
+        lines.append(patterns[line % patterns.size()]);
+    }
+    return lines;
+}
+
+static QVector<SyntaxRuns> highlightLines(HighlightExporter &exporter, const QStringList &lines, int begin, int end) {
+    QVector<SyntaxRuns> runs;
+    KSyntaxHighlighting::State state;
+    for (int line = begin; line < end; line++) {
+        auto res = exporter.highlightLineWrap(lines[line], state);
+        state = std::get<0>(res);
+        runs.append(std::get<1>(res));
+    }
+    return runs;
+}
+
+// Highlights like the paint event does, false when another thread held the lock.
+static bool paintLines(HighlightExporter &exporter, const QStringList &lines, int begin, int end,
+                       QVector<SyntaxRuns> &runs) {
+    runs.clear();
+    KSyntaxHighlighting::State state;
+    for (int line = begin; line < end; line++) {
+        auto res = exporter.tryHighlightLineWrap(lines[line], state);
+        if (!res) {
+            return false;
+        }
+        state = std::get<0>(*res);
+        runs.append(std::get<1>(*res));
+    }
+    return true;
+}
+
+namespace {
+    struct Chunk {
+        int begin = 0;
+        int end = 0;
+        QVector<SyntaxRuns> runs;
+    };
+}
+
+static QVector<Chunk> makeChunks(int begin, int end, int chunkLines) {
+    QVector<Chunk> chunks;
+    for (int chunkBegin = begin; chunkBegin < end; chunkBegin += chunkLines) {
+        chunks.append(Chunk{chunkBegin, std::min(chunkBegin + chunkLines, end), {}});
+    }
+    return chunks;
+}
+
+static void checkAgainstSerial(const KSyntaxHighlighting::Definition &definition,
+                               std::shared_ptr<SyntaxFormatTable> formatTable, const QStringList &lines,
+                               const QVector<Chunk> &chunks) {
+    HighlightExporter reference;
+    reference.setFormatTable(formatTable);
+    reference.setDefinition(definition);
+    for (const Chunk &chunk: chunks) {
+        CAPTURE(chunk.begin);
+        CHECK(chunk.runs == highlightLines(reference, lines, chunk.begin, chunk.end));
+    }
+}
+
+TEST_CASE("highlighterpool-parallel-fresh-definition") {
+    const QStringList lines = cppLines(8000);
+
+    for (int round = 0; round < 5; round++) {
+        CAPTURE(round);
+        // Nothing of the definition was prepared by an earlier round.
+        KSyntaxHighlighting::Repository repository;
+        KSyntaxHighlighting::Definition definition = repository.definitionForName("C++");
+        REQUIRE(definition.isValid());
+        definition.includedDefinitions();
+
+        auto formatTable = std::make_shared<SyntaxFormatTable>();
+        auto definitionLock = syntaxDefinitionLock(definition);
+        auto pool = std::make_shared<HighlighterPool>(formatTable);
+        pool->configure(definition, definitionLock);
+
+        QVector<Chunk> chunks = makeChunks(0, lines.size(), 250);
+        QFuture<void> future = QtConcurrent::map(chunks, [&](Chunk &chunk) {
+            HighlighterPool::Lease highlighter = pool->acquire();
+            chunk.runs = highlightLines(*highlighter, lines, chunk.begin, chunk.end);
+        });
+
+        // Meanwhile the main thread paints with the same definition.
+        HighlightExporter painter;
+        painter.setFormatTable(formatTable);
+        painter.setDefinition(definition);
+        painter.setDefinitionLock(definitionLock);
+        QVector<SyntaxRuns> painted;
+        bool paintedComplete = false;
+        while (!future.isFinished()) {
+            QVector<SyntaxRuns> runs;
+            if (paintLines(painter, lines, 0, 250, runs)) {
+                painted = runs;
+                paintedComplete = true;
+            }
+        }
+        future.waitForFinished();
+
+        checkAgainstSerial(definition, formatTable, lines, chunks);
+        if (paintedComplete) {
+            CHECK(painted == chunks[0].runs);
+        }
+    }
+}
+
+TEST_CASE("highlighterpool-new-rules-after-warm-up") {
+    // Only a few rules are used at first, the rest is reached for the first time from several threads.
+    QStringList lines;
+    for (int line = 0; line < 3000; line++) {
+        lines.append("int x;");
+    }
+    lines.append(cppLines(6000));
+
+    KSyntaxHighlighting::Repository repository;
+    KSyntaxHighlighting::Definition cpp = repository.definitionForName("C++");
+    KSyntaxHighlighting::Definition c = repository.definitionForName("C");
+    REQUIRE(cpp.isValid());
+    REQUIRE(c.isValid());
+    cpp.includedDefinitions();
+    c.includedDefinitions();
+
+    // Both include e.g. the Doxygen definition.
+    auto formatTable = std::make_shared<SyntaxFormatTable>();
+    auto cppPool = std::make_shared<HighlighterPool>(formatTable);
+    cppPool->configure(cpp, syntaxDefinitionLock(cpp));
+    auto cPool = std::make_shared<HighlighterPool>(formatTable);
+    cPool->configure(c, syntaxDefinitionLock(c));
+
+    {
+        HighlighterPool::Lease highlighter = cppPool->acquire();
+        highlightLines(*highlighter, lines, 0, 3000);
+    }
+
+    QVector<Chunk> cppChunks = makeChunks(3000, lines.size(), 200);
+    QVector<Chunk> cChunks = makeChunks(3000, lines.size(), 200);
+    QFuture<void> cppFuture = QtConcurrent::map(cppChunks, [&](Chunk &chunk) {
+        HighlighterPool::Lease highlighter = cppPool->acquire();
+        chunk.runs = highlightLines(*highlighter, lines, chunk.begin, chunk.end);
+    });
+    QFuture<void> cFuture = QtConcurrent::map(cChunks, [&](Chunk &chunk) {
+        HighlighterPool::Lease highlighter = cPool->acquire();
+        chunk.runs = highlightLines(*highlighter, lines, chunk.begin, chunk.end);
+    });
+    cppFuture.waitForFinished();
+    cFuture.waitForFinished();
+
+    checkAgainstSerial(cpp, formatTable, lines, cppChunks);
+    checkAgainstSerial(c, formatTable, lines, cChunks);
+}
+
+#endif
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "../mappedfile.h"
+
+static void waitForIndex(const MappedFile &mappedFile) {
+    while (!mappedFile.indexComplete()) {
+        QThread::msleep(1);
+    }
+}
+
+TEST_CASE("mappedfile") {
+    QTemporaryDir dir;
+    QString filename = dir.path() + "/file";
+
+    auto writeFile = [&](const QByteArray &content) {
+        QFile file(filename);
+        REQUIRE(file.open(QIODevice::WriteOnly));
+        file.write(content);
+        file.close();
+    };
+
+    SECTION("empty") {
+        writeFile("");
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.lineCount() == 1);
+        CHECK(mappedFile.line(0) == "");
+        CHECK(mappedFile.lines(0, 10) == QStringList{""});
+        CHECK(mappedFile.newlineAfterLastLineMissing() == false);
+    }
+
+    SECTION("newline at end") {
+        writeFile("a\nbb\nccc\n");
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.lineCount() == 3);
+        CHECK(mappedFile.lines(0, 10) == QStringList{"a", "bb", "ccc"});
+        CHECK(mappedFile.lines(1, 1) == QStringList{"bb"});
+        CHECK(mappedFile.newlineAfterLastLineMissing() == false);
+        CHECK(mappedFile.crLfMode() == false);
+    }
+
+    SECTION("no newline at end") {
+        writeFile("a\nbb\nccc");
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.lineCount() == 3);
+        CHECK(mappedFile.line(2) == "ccc");
+        CHECK(mappedFile.newlineAfterLastLineMissing() == true);
+    }
+
+    SECTION("crlf") {
+        writeFile("a\r\nbb\r\n");
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.crLfMode() == true);
+        CHECK(mappedFile.lines(0, 2) == QStringList{"a", "bb"});
+    }
+
+    SECTION("many lines") {
+        QByteArray content;
+        for (int i = 0; i < 1000; i++) {
+            content += QByteArray::number(i) + "\n";
+        }
+        writeFile(content);
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.lineCount() == 1000);
+        for (int i : {0, 1, 63, 64, 65, 127, 128, 500, 999}) {
+            CAPTURE(i);
+            CHECK(mappedFile.line(i) == QString::number(i));
+        }
+        CHECK(mappedFile.lines(998, 10) == QStringList{"998", "999"});
+        CHECK(mappedFile.line(1000) == "");
+    }
+
+    SECTION("truncated while open") {
+        QByteArray content;
+        for (int i = 0; i < 100000; i++) {
+            content += QByteArray::number(i) + "\n";
+        }
+
+        for (bool indexed: {false, true}) {
+            CAPTURE(indexed);
+            writeFile(content);
+            MappedFile mappedFile;
+            REQUIRE(mappedFile.open(filename));
+            if (indexed) {
+                waitForIndex(mappedFile);
+                CHECK(mappedFile.lineCount() == 100000);
+            }
+
+            // Like a log that is rotated while shown, only the first 10 lines remain.
+            QFile file(filename);
+            REQUIRE(file.resize(20));
+
+            waitForIndex(mappedFile);
+            CHECK(mappedFile.lineCount() <= 100000);
+            CHECK(mappedFile.line(50000) == "");
+            CHECK(mappedFile.line(99999) == "");
+            CHECK(mappedFile.size() == 20);
+            CHECK(mappedFile.line(5) == "5");
+            CHECK(mappedFile.line(9) == "9");
+            CHECK(mappedFile.line(10) == "");
+            for (const QString &line: mappedFile.lines(99990, 10)) {
+                CHECK(line == "");
+            }
+            CHECK(mappedFile.newlineAfterLastLineMissing() == false);
+        }
+    }
+
+    SECTION("invalid utf8") {
+        writeFile("a\xff" "b\n");
+        MappedFile mappedFile;
+        REQUIRE(mappedFile.open(filename));
+        waitForIndex(mappedFile);
+        CHECK(mappedFile.line(0) == QString("a") + QChar(0xdcff) + QString("b"));
+    }
+}
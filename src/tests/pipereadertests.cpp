@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <unistd.h>
+
+#include <QThread>
+
+#include "../pipereader.h"
+#include "../spscqueue.h"
+
+TEST_CASE("spscqueue") {
+    SpscQueue<int> queue(2);
+    CHECK(queue.empty());
+    CHECK(queue.capacity() == 2);
+    CHECK(queue.push(1));
+    CHECK(queue.push(2));
+    CHECK(!queue.push(3));
+    CHECK(queue.pop() == 1);
+    CHECK(queue.push(3));
+    CHECK(queue.pop() == 2);
+    CHECK(queue.pop() == 3);
+    CHECK(queue.pop() == std::nullopt);
+    CHECK(queue.empty());
+}
+
+TEST_CASE("pipereader") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    PipeReader reader(fds[0]);
+    reader.start();
+
+    auto readAll = [&reader] {
+        QStringList lines;
+        while (true) {
+            std::optional<PipeBatch> batch = reader.takeBatch();
+            if (!batch) {
+                QThread::msleep(1);
+                continue;
+            }
+            lines += batch->lines;
+            if (batch->eof) {
+                return lines;
+            }
+        }
+    };
+
+    SECTION("lines") {
+        const QByteArray data = "abc\ndef\n\xff\nlast";
+        REQUIRE(write(fds[1], data.constData(), data.size()) == data.size());
+        ::close(fds[1]);
+        CHECK(readAll() == QStringList{"abc", "def", QString(QChar(0xdcff)), "last"});
+    }
+
+    SECTION("many batches") {
+        // More data than fits into the queue, the reader has to wait until batches are taken.
+        QByteArray line = QByteArray(99, 'x') + "\n";
+        QThread *writer = QThread::create([&] {
+            for (int i = 0; i < 100000; i++) {
+                if (write(fds[1], line.constData(), line.size()) != line.size()) {
+                    break;
+                }
+            }
+            ::close(fds[1]);
+        });
+        writer->start();
+        QThread::msleep(50);
+        const QStringList lines = readAll();
+        writer->wait();
+        delete writer;
+        CHECK(lines.size() == 100000);
+        CHECK(lines.last() == QString(99, 'x'));
+    }
+
+    SECTION("long line") {
+        // Without line breaks the input is split into lines, but not in the middle of a character.
+        QByteArray text = "a";
+        while (text.size() < 2 * PipeReader::maxLineBytes + 100) {
+            text += "\xc3\xa4";
+        }
+        QThread *writer = QThread::create([&] {
+            const QByteArray data = text + "\nend";
+            qint64 written = 0;
+            while (written < data.size()) {
+                const ssize_t result = write(fds[1], data.constData() + written, data.size() - written);
+                if (result <= 0) {
+                    break;
+                }
+                written += result;
+            }
+            ::close(fds[1]);
+        });
+        writer->start();
+        QStringList lines = readAll();
+        writer->wait();
+        delete writer;
+        REQUIRE(lines.size() >= 3);
+        CHECK(lines.takeLast() == "end");
+        CHECK(lines.join("") == QString::fromUtf8(text));
+    }
+
+    SECTION("stop while idle") {
+        // Nothing is written, the thread waits in poll and has to be woken.
+        reader.stop();
+        CHECK(reader.isFinished());
+        ::close(fds[1]);
+    }
+
+    reader.stop();
+    ::close(fds[0]);
+}
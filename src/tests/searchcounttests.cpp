@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <Tui/ZDocument.h>
+#include <Tui/ZDocumentCursor.h>
+#include <Tui/ZDocumentSnapshot.h>
+#include <Tui/ZTerminal.h>
+#include <Tui/ZTextLayout.h>
+#include <Tui/ZTextMetrics.h>
+
+#include "../searchcount.h"
+
+namespace {
+    struct CountResult {
+        // -2 when no complete count was reported.
+        int count = -2;
+        bool indexReported = false;
+        std::shared_ptr<const SearchIndex> index;
+    };
+
+    class SearchCountTestDocument {
+    public:
+        SearchCountTestDocument(const QString &text)
+            : terminal(offScreen),
+              cursor(&doc, [this](int line, bool wrappingAllowed) {
+                  (void)wrappingAllowed;
+                  Tui::ZTextLayout lay(terminal.textMetrics(), doc.line(line));
+                  lay.doLayout(65000);
+                  return lay;
+              })
+        {
+            cursor.insertText(text);
+        }
+
+        void insertText(Tui::ZDocumentCursor::Position pos, const QString &text) {
+            cursor.setPosition(pos);
+            cursor.insertText(text);
+        }
+
+        void remove(Tui::ZDocumentCursor::Position start, Tui::ZDocumentCursor::Position end) {
+            cursor.setPosition(start);
+            cursor.setPosition(end, true);
+            cursor.removeSelectedText();
+        }
+
+    public:
+        Tui::ZTerminal::OffScreen offScreen{80, 24};
+        Tui::ZTerminal terminal;
+        Tui::ZDocument doc;
+        Tui::ZDocumentCursor cursor;
+    };
+}
+
+static CountResult count(Tui::ZDocumentSnapshot snap, std::shared_ptr<const SearchIndex> previous, const QString &text,
+                         bool regex, Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive,
+                         std::shared_ptr<std::atomic<int>> searchGen = std::make_shared<std::atomic<int>>(1)) {
+    CountResult result;
+    SearchCount sc;
+    QObject::connect(&sc, &SearchCount::searchCount, [&](int found, bool complete) {
+        if (complete) {
+            result.count = found;
+        }
+    });
+    QObject::connect(&sc, &SearchCount::searchIndex, [&](std::shared_ptr<const SearchIndex> index) {
+        result.indexReported = true;
+        result.index = index;
+    });
+    if (previous) {
+        sc.update(snap, previous, text, caseSensitivity, regex, 1, searchGen);
+    } else {
+        sc.run(snap, text, caseSensitivity, regex, 1, searchGen);
+    }
+    return result;
+}
+
+static QStringList describe(const QVector<SearchMatch> &matches) {
+    QStringList result;
+    for (const SearchMatch &match: matches) {
+        result.append(QString("%1:%2-%3:%4").arg(match.start.line).arg(match.start.codeUnit)
+                      .arg(match.end.line).arg(match.end.codeUnit));
+    }
+    return result;
+}
+
+TEST_CASE("searchcount-literal") {
+    SearchCountTestDocument t("abcabc\nxabc\n\nab\nABC");
+
+    SECTION("case-sensitive") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "abc", false);
+        CHECK(result.count == 3);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:0-0:3", "0:3-0:6", "1:1-1:4"});
+        CHECK(result.index->documentRevision == t.doc.revision());
+        CHECK(result.index->lineRevisions.size() == t.doc.lineCount());
+    }
+
+    SECTION("case-insensitive") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "aBc", false, Qt::CaseInsensitive);
+        CHECK(result.count == 4);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:0-0:3", "0:3-0:6", "1:1-1:4", "4:0-4:3"});
+    }
+
+    SECTION("no-match") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "abd", false);
+        CHECK(result.count == 0);
+        REQUIRE(result.index);
+        CHECK(result.index->matches.isEmpty());
+    }
+}
+
+TEST_CASE("searchcount-regex") {
+    SearchCountTestDocument t("a1b22c333\nno digits\n4");
+
+    SECTION("matches") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "[0-9]+", true);
+        CHECK(result.count == 4);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:1-0:2", "0:3-0:5", "0:6-0:9", "2:0-2:1"});
+    }
+
+    SECTION("case-insensitive") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "DIGIT[S]", true, Qt::CaseInsensitive);
+        CHECK(result.count == 1);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"1:3-1:9"});
+    }
+
+    SECTION("invalid") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "(", true);
+        CHECK(result.count == -1);
+        CHECK(result.indexReported);
+        CHECK(!result.index);
+    }
+}
+
+TEST_CASE("searchcount-empty-match") {
+    SearchCountTestDocument t("abxxc\nabc");
+
+    SECTION("partly-empty") {
+        // Only the non empty matches are counted.
+        CountResult result = count(t.doc.snapshot(), nullptr, "x*", true);
+        CHECK(result.count == 1);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:2-0:4"});
+    }
+
+    SECTION("only-empty") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "^", true);
+        CHECK(result.count == 0);
+        REQUIRE(result.index);
+        CHECK(result.index->matches.isEmpty());
+    }
+}
+
+TEST_CASE("searchcount-multi-line") {
+    SearchCountTestDocument t("foo\nbar\nfoo\nbarbar\nxfoo\nba");
+
+    SECTION("two-lines") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "foo\nbar", false);
+        CHECK(result.count == 2);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:0-1:3", "2:0-3:3"});
+    }
+
+    SECTION("three-lines") {
+        // The line in between has to match completely.
+        CountResult result = count(t.doc.snapshot(), nullptr, "o\nbar\nf", false);
+        CHECK(result.count == 1);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:2-2:1"});
+    }
+
+    SECTION("at-end") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "foo\nba", false);
+        CHECK(result.count == 3);
+        REQUIRE(result.index);
+        CHECK(describe(result.index->matches) == QStringList{"0:0-1:2", "2:0-3:2", "4:1-5:2"});
+    }
+
+    SECTION("case-insensitive") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "FOO\nBAR", false, Qt::CaseInsensitive);
+        CHECK(result.count == 2);
+    }
+}
+
+TEST_CASE("searchcount-update") {
+    // Enough lines for several chunks.
+    QStringList lines;
+    for (int i = 0; i < 5000; i++) {
+        lines.append(i % 3 == 0 ? QString("line %1 abc").arg(i) : QString("line %1").arg(i));
+    }
+    SearchCountTestDocument t(lines.join("\n"));
+
+    const auto [text, regex] = GENERATE(std::make_tuple(QString("abc"), false),
+                                        std::make_tuple(QString("a.c"), true),
+                                        std::make_tuple(QString("abc\nline"), false));
+    CAPTURE(text);
+    CAPTURE(regex);
+
+    CountResult before = count(t.doc.snapshot(), nullptr, text, regex);
+    REQUIRE(before.index);
+
+    SECTION("insert-above") {
+        t.insertText({0, 0}, "new abc\nnew\n");
+    }
+
+    SECTION("insert-inside") {
+        t.insertText({0, 2500}, "new abc\nline abc\n");
+    }
+
+    SECTION("insert-below") {
+        t.insertText({t.doc.lineCodeUnits(4999), 4999}, "\nnew abc\nline");
+    }
+
+    SECTION("delete-above") {
+        t.remove({0, 0}, {0, 2});
+    }
+
+    SECTION("delete-inside") {
+        t.remove({3, 1000}, {2, 3500});
+    }
+
+    SECTION("delete-below") {
+        t.remove({t.doc.lineCodeUnits(4990), 4990}, {t.doc.lineCodeUnits(4999), 4999});
+    }
+
+    SECTION("edit-match") {
+        // Breaks up the match in this line and joins two lines.
+        t.insertText({11, 3000}, "X");
+        t.remove({t.doc.lineCodeUnits(3003), 3003}, {0, 3004});
+    }
+
+    SECTION("several-places") {
+        t.remove({0, 10}, {0, 20});
+        t.insertText({0, 2000}, "abc\nabc\n");
+        t.insertText({0, 4000}, "line abc");
+    }
+
+    CountResult updated = count(t.doc.snapshot(), before.index, text, regex);
+    CountResult fresh = count(t.doc.snapshot(), nullptr, text, regex);
+    CHECK(updated.count == fresh.count);
+    REQUIRE(updated.index);
+    REQUIRE(fresh.index);
+    CHECK(updated.index->documentRevision == fresh.index->documentRevision);
+    CHECK(updated.index->lineRevisions == fresh.index->lineRevisions);
+    CHECK(describe(updated.index->matches) == describe(fresh.index->matches));
+}
+
+TEST_CASE("searchcount-cancel") {
+    QStringList lines;
+    for (int i = 0; i < 5000; i++) {
+        lines.append("abc");
+    }
+    SearchCountTestDocument t(lines.join("\n"));
+    // A new search was started, the job is for generation 1.
+    auto searchGen = std::make_shared<std::atomic<int>>(2);
+
+    SECTION("run") {
+        CountResult result = count(t.doc.snapshot(), nullptr, "abc", false, Qt::CaseSensitive, searchGen);
+        CHECK(result.count == -2);
+        CHECK(result.indexReported);
+        CHECK(!result.index);
+    }
+
+    SECTION("update") {
+        CountResult before = count(t.doc.snapshot(), nullptr, "abc", false);
+        REQUIRE(before.index);
+        t.insertText({0, 100}, "abc\n");
+        CountResult result = count(t.doc.snapshot(), before.index, "abc", false, Qt::CaseSensitive, searchGen);
+        CHECK(result.count == -2);
+        CHECK(result.indexReported);
+        CHECK(!result.index);
+    }
+}
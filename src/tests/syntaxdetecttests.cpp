@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include "../syntaxdetect.h"
+
+TEST_CASE("syntaxdetect-shebang") {
+    CHECK(detectSyntaxHint({"#!/bin/sh", "echo"}, {}).filename == "script.sh");
+    CHECK(detectSyntaxHint({"#! /bin/bash -e"}, {}).filename == "script.sh");
+    CHECK(detectSyntaxHint({"#!/usr/bin/env python3"}, {}).filename == "script.py");
+    CHECK(detectSyntaxHint({"#!/usr/bin/env -S python3.11 -u"}, {}).filename == "script.py");
+    CHECK(detectSyntaxHint({"#!/usr/bin/env LANG=C perl -w"}, {}).filename == "script.pl");
+
+    const SyntaxHint unknown = detectSyntaxHint({"#!/usr/local/bin/guile -s"}, {});
+    CHECK(unknown.filename.isEmpty());
+    CHECK(unknown.name == "guile");
+
+    CHECK(detectSyntaxHint({"#!"}, {}).isEmpty());
+}
+
+TEST_CASE("syntaxdetect-modeline") {
+    CHECK(detectSyntaxHint({"// kate: indent-width 4; hl C++;"}, {}).name == "C++");
+    CHECK(detectSyntaxHint({"x"}, {"# vim: set ft=python :"}).name == "python");
+    CHECK(detectSyntaxHint({"/* vi: syntax=sh */"}, {}).name == "sh");
+    CHECK(detectSyntaxHint({"#!/bin/sh", "# -*- mode: python; coding: utf-8 -*-"}, {}).name == "python");
+    CHECK(detectSyntaxHint({";; -*- lisp -*-"}, {}).name == "lisp");
+    CHECK(detectSyntaxHint({"# -*- coding: utf-8 -*-"}, {}).isEmpty());
+
+    // modelines win over the shebang
+    const SyntaxHint hint = detectSyntaxHint({"#!/bin/sh"}, {"# vim: ft=zsh"});
+    CHECK(hint.name == "zsh");
+    CHECK(hint.filename.isEmpty());
+
+    // only the first and last lines are looked at
+    QStringList head;
+    for (int i = 0; i < 10; i++) {
+        head.append("");
+    }
+    head.append("# vim: ft=python");
+    CHECK(detectSyntaxHint(head, {}).isEmpty());
+}
+
+TEST_CASE("syntaxdetect-content") {
+    CHECK(detectSyntaxHint({"<?xml version=\"1.0\"?>", "<a/>"}, {}).name == "XML");
+    CHECK(detectSyntaxHint({"", "<!doctype html>"}, {}).name == "HTML");
+    CHECK(detectSyntaxHint({"diff --git a/x b/x"}, {}).name == "Diff");
+    CHECK(detectSyntaxHint({"--- a/x", "+++ b/x"}, {}).name == "Diff");
+    CHECK(detectSyntaxHint({"; comment", "[section]", "key=value"}, {}).name == "INI Files");
+    CHECK(detectSyntaxHint({"2024-05-01 12:00:00 start", "2024-05-01 12:00:01 stop"}, {}).name == "Log File (simplified)");
+    CHECK(detectSyntaxHint({"May  1 12:00:00 host sshd[1]: x", "May  1 12:00:01 host sshd[1]: y"}, {}).name
+          == "Log File (simplified)");
+    CHECK(detectSyntaxHint({"just some text", "more text"}, {}).isEmpty());
+    CHECK(detectSyntaxHint({}, {}).isEmpty());
+}
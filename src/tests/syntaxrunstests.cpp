@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include "../syntaxruns.h"
+
+TEST_CASE("syntaxruns-empty") {
+    SyntaxRuns runs;
+    CHECK(runs.isEmpty());
+    CHECK(runs.size() == 0);
+    CHECK(runs.memoryUsage() == 0);
+}
+
+TEST_CASE("syntaxruns-append") {
+    SyntaxRuns runs;
+    runs.append(0, 4, 7);
+    runs.append(5, 3, 2);
+    runs.append(100000, 10, 65535);
+    REQUIRE(runs.size() == 3);
+    CHECK(runs.at(0).offset == 0);
+    CHECK(runs.at(0).length == 4);
+    CHECK(runs.at(0).formatId == 7);
+    CHECK(runs.at(1).offset == 5);
+    CHECK(runs.at(1).length == 3);
+    CHECK(runs.at(1).formatId == 2);
+    CHECK(runs.at(2).offset == 100000);
+    CHECK(runs.at(2).length == 10);
+    CHECK(runs.at(2).formatId == 65535);
+}
+
+TEST_CASE("syntaxruns-merge") {
+    SyntaxRuns runs;
+
+    SECTION("adjacent-same-format") {
+        runs.append(0, 4, 1);
+        runs.append(4, 6, 1);
+        REQUIRE(runs.size() == 1);
+        CHECK(runs.at(0).offset == 0);
+        CHECK(runs.at(0).length == 10);
+    }
+
+    SECTION("adjacent-other-format") {
+        runs.append(0, 4, 1);
+        runs.append(4, 6, 2);
+        CHECK(runs.size() == 2);
+    }
+
+    SECTION("gap") {
+        runs.append(0, 4, 1);
+        runs.append(5, 6, 1);
+        CHECK(runs.size() == 2);
+    }
+}
+
+TEST_CASE("syntaxruns-long-range") {
+    SyntaxRuns runs;
+    runs.append(10, 0xffff * 2 + 5, 3);
+    REQUIRE(runs.size() == 3);
+    CHECK(runs.at(0).offset == 10);
+    CHECK(runs.at(0).length == 0xffff);
+    CHECK(runs.at(1).offset == 10 + 0xffff);
+    CHECK(runs.at(1).length == 0xffff);
+    CHECK(runs.at(2).offset == 10 + 0xffff * 2);
+    CHECK(runs.at(2).length == 5);
+    CHECK(runs.at(2).formatId == 3);
+}
+
+TEST_CASE("syntaxruns-invalid") {
+    SyntaxRuns runs;
+    runs.append(-1, 4, 1);
+    runs.append(3, 0, 1);
+    CHECK(runs.isEmpty());
+}
+
+TEST_CASE("syntaxruns-compare") {
+    SyntaxRuns a;
+    SyntaxRuns b;
+    a.append(0, 4, 1);
+    CHECK(a != b);
+    b.append(0, 2, 1);
+    b.append(2, 2, 1);
+    CHECK(a == b);
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "catchwrapper.h"
+
+#include <string.h>
+
+#include <QByteArray>
+
+#include <Tui/Misc/SurrogateEscape.h>
+
+#include "../textdecoder.h"
+
+TEST_CASE("textdecoder-findNewline") {
+    // cover the vector loops and the scalar tail
+    for (int size : {0, 1, 15, 16, 17, 31, 32, 33, 100}) {
+        for (int pos = 0; pos <= size; pos++) {
+            CAPTURE(size);
+            CAPTURE(pos);
+            QByteArray data(size, 'x');
+            if (pos < size) {
+                data[pos] = '\n';
+            }
+            const char *found = findNewline(data.constData(), data.constData() + size);
+            if (pos < size) {
+                CHECK(found == data.constData() + pos);
+            } else {
+                CHECK(found == nullptr);
+            }
+        }
+    }
+}
+
+TEST_CASE("textdecoder-isAscii") {
+    for (int size : {1, 15, 16, 17, 31, 32, 33, 100}) {
+        for (int pos = 0; pos < size; pos++) {
+            CAPTURE(size);
+            CAPTURE(pos);
+            QByteArray data(size, 'x');
+            CHECK(isAscii(data.constData(), size));
+            data[pos] = '\x80';
+            CHECK(!isAscii(data.constData(), size));
+        }
+    }
+}
+
+TEST_CASE("textdecoder-isValidUtf8") {
+    auto valid = [](const char *text) {
+        return isValidUtf8(text, strlen(text));
+    };
+
+    CHECK(valid(""));
+    CHECK(valid("abc"));
+    CHECK(valid("\xc3\xa4"));
+    CHECK(valid("\xe2\x82\xac"));
+    CHECK(valid("\xf0\x9f\x98\x80"));
+    CHECK(valid("\xf4\x8f\xbf\xbf"));
+
+    // overlong
+    CHECK(!valid("\xc0\x80"));
+    CHECK(!valid("\xe0\x80\xaf"));
+    CHECK(!valid("\xf0\x80\x80\xaf"));
+    // surrogate
+    CHECK(!valid("\xed\xa0\x80"));
+    // above U+10FFFF
+    CHECK(!valid("\xf4\x90\x80\x80"));
+    // truncated
+    CHECK(!valid("\xc3"));
+    CHECK(!valid("a\xe2\x82"));
+    // stray continuation byte
+    CHECK(!valid("\x80"));
+    CHECK(!valid("\xff"));
+
+    QByteArray longText = QByteArray(100, 'x') + "\xc3\xa4" + QByteArray(50, 'y');
+    CHECK(isValidUtf8(longText.constData(), longText.size()));
+    longText[120] = '\xff';
+    CHECK(!isValidUtf8(longText.constData(), longText.size()));
+}
+
+TEST_CASE("textdecoder-decodeText") {
+    auto check = [](const QByteArray &data) {
+        CAPTURE(data);
+        CHECK(decodeText(data.constData(), data.size()) == Tui::Misc::SurrogateEscape::decode(data));
+    };
+
+    check("");
+    check("abc\ndef");
+    check(QByteArray(100, 'x'));
+    check("\xc3\xa4\xe2\x82\xac");
+    check("a\xff" "b");
+    check("\xed\xa0\x80");
+    check("\xc0\x80");
+    check("\xef\xbb\xbf" "abc");
+    check(QByteArray("a\0b", 3));
+}
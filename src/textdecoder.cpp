@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#include "textdecoder.h"
+
+#include <string.h>
+
+#include <QByteArray>
+
+#include <Tui/Misc/SurrogateEscape.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define TEXTDECODER_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef TEXTDECODER_X86
+
+static bool hasAvx2() {
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+}
+
+__attribute__((target("avx2")))
+static const char *findNewlineAvx2(const char *p, const char *end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return static_cast<const char*>(memchr(p, '\n', end - p));
+}
+
+static const char *findNewlineSse2(const char *p, const char *end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return static_cast<const char*>(memchr(p, '\n', end - p));
+}
+
+__attribute__((target("avx2")))
+static const char *skipAsciiAvx2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (_mm256_movemask_epi8(v)) {
+            break;
+        }
+        p += 32;
+    }
+    return p;
+}
+
+static const char *skipAsciiSse2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (_mm_movemask_epi8(v)) {
+            break;
+        }
+        p += 16;
+    }
+    return p;
+}
+
+#endif
+
+// Returns a pointer into [p, end] that is at most a few bytes before the first non ASCII byte.
+static const char *skipAscii(const char *p, const char *end) {
+#ifdef TEXTDECODER_X86
+    if (hasAvx2()) {
+        p = skipAsciiAvx2(p, end);
+    }
+    p = skipAsciiSse2(p, end);
+#endif
+    while (p < end && static_cast<unsigned char>(*p) < 0x80) {
+        p++;
+    }
+    return p;
+}
+
+const char *findNewline(const char *begin, const char *end) {
+    if (begin >= end) {
+        return nullptr;
+    }
+#ifdef TEXTDECODER_X86
+    if (hasAvx2()) {
+        return findNewlineAvx2(begin, end);
+    }
+    return findNewlineSse2(begin, end);
+#else
+    return static_cast<const char*>(memchr(begin, '\n', end - begin));
+#endif
+}
+
+bool isAscii(const char *data, qint64 size) {
+    return skipAscii(data, data + size) == data + size;
+}
+
+bool isValidUtf8(const char *data, qint64 size) {
+    const char *p = data;
+    const char *end = data + size;
+
+    while (true) {
+        p = skipAscii(p, end);
+        if (p == end) {
+            return true;
+        }
+
+        const unsigned char first = *p;
+        int length;
+        char32_t codePoint;
+        char32_t minimum;
+        if ((first & 0xe0) == 0xc0) {
+            length = 2;
+            codePoint = first & 0x1f;
+            minimum = 0x80;
+        } else if ((first & 0xf0) == 0xe0) {
+            length = 3;
+            codePoint = first & 0x0f;
+            minimum = 0x800;
+        } else if ((first & 0xf8) == 0xf0) {
+            length = 4;
+            codePoint = first & 0x07;
+            minimum = 0x10000;
+        } else {
+            // continuation byte without start byte or invalid start byte
+            return false;
+        }
+
+        if (end - p < length) {
+            return false;
+        }
+        for (int i = 1; i < length; i++) {
+            const unsigned char continuation = p[i];
+            if ((continuation & 0xc0) != 0x80) {
+                return false;
+            }
+            codePoint = (codePoint << 6) | (continuation & 0x3f);
+        }
+        if (codePoint < minimum || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+            return false;
+        }
+        p += length;
+    }
+}
+
+QString decodeText(const char *data, int size) {
+    if (isAscii(data, size)) {
+        return QString::fromLatin1(data, size);
+    }
+
+    // QString::fromUtf8 would drop a byte order mark, leave that case to the generic decoder.
+    const bool startsWithBom = size >= 3 && memcmp(data, "\xef\xbb\xbf", 3) == 0;
+    if (!startsWithBom && isValidUtf8(data, size)) {
+        return QString::fromUtf8(data, size);
+    }
+
+    return Tui::Misc::SurrogateEscape::decode(QByteArray::fromRawData(data, size));
+}
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: BSL-1.0
+
+#ifndef TEXTDECODER_H
+#define TEXTDECODER_H
+
+#include <QString>
+
+// Helpers for the file loading hot path. They use SSE2 or AVX2 where available and fall back to portable code.
+
+// Returns a pointer to the first '\n' in [begin, end) or nullptr if there is none.
+const char *findNewline(const char *begin, const char *end);
+
+bool isAscii(const char *data, qint64 size);
+
+// Strict check: Overlong sequences, surrogates and code points above U+10FFFF are rejected.
+bool isValidUtf8(const char *data, qint64 size);
+
+// Same result as Tui::Misc::SurrogateEscape::decode, but pure ASCII and valid UTF-8 input take a faster path.
+QString decodeText(const char *data, int size);
+
+#endif // TEXTDECODER_H